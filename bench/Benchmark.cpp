@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+static thread_local std::uint64_t allocations = 0;
+
+// Count every allocation by replacing the global operator new. The array and
+// nothrow versions forward to these. The count is per thread, so the threads
+// of the generator don't add to the benchmark that runs on this one.
+void* operator new(std::size_t size) {
+	allocations++;
+
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	allocations++;
+
+	// the size of an aligned allocation is a multiple of its alignment
+	auto align = static_cast<std::size_t>(alignment);
+	size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+
+#ifdef _WIN32
+	void* ptr = _aligned_malloc(size, align);
+#else
+	void* ptr = std::aligned_alloc(align, size);
+#endif
+
+	if (ptr) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+	operator delete(ptr, alignment);
+}
+
+std::uint64_t allocationCount() {
+	return allocations;
+}
+
+void runBenchmarks(const std::vector<Benchmark>& benchmarks, std::chrono::milliseconds minTime, std::string_view filter, std::ostream& output) {
+	using Clock = std::chrono::steady_clock;
+
+	auto flags = output.flags();
+
+	output << std::left << std::setw(32) << "Benchmark" << std::right
+			<< std::setw(14) << "ns/op"
+			<< std::setw(12) << "MB/s"
+			<< std::setw(12) << "allocs/op"
+			<< std::setw(12) << "ops" << std::endl;
+
+	for (const auto& benchmark : benchmarks) {
+		if (benchmark.name.find(filter) == std::string::npos || benchmark.count == 0) {
+			continue;
+		}
+
+		// warm up the caches, then double the number of passes until a batch
+		// takes long enough to measure
+		benchmark.pass();
+
+		std::uint64_t passes = 1;
+		std::chrono::nanoseconds elapsed;
+		std::uint64_t allocated;
+
+		while (true) {
+			std::uint64_t allocationsBefore = allocationCount();
+			auto start = Clock::now();
+
+			for (std::uint64_t i = 0; i < passes; i++) {
+				benchmark.pass();
+			}
+
+			elapsed = Clock::now() - start;
+			allocated = allocationCount() - allocationsBefore;
+
+			if (elapsed >= minTime) {
+				break;
+			}
+
+			passes *= 2;
+		}
+
+		double ops = static_cast<double>(passes) * static_cast<double>(benchmark.count);
+		double seconds = std::chrono::duration<double>(elapsed).count();
+
+		output << std::left << std::setw(32) << benchmark.name << std::right << std::fixed
+				<< std::setprecision(1) << std::setw(14) << static_cast<double>(elapsed.count()) / ops
+				<< std::setprecision(2) << std::setw(12) << static_cast<double>(benchmark.bytes) * static_cast<double>(passes) / seconds / 1e6
+				<< std::setprecision(1) << std::setw(12) << static_cast<double>(allocated) / ops
+				<< std::setw(12) << static_cast<std::uint64_t>(ops) << std::endl;
+	}
+
+	output.flags(flags);
+}
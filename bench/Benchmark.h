@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_BENCHMARK_H
+#define GLWR_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * A microbenchmark. Every run of pass does count operations on bytes bytes of
+ * input in total.
+ */
+struct Benchmark {
+	std::string name;
+	std::size_t count;
+	std::uint64_t bytes;
+	std::function<void()> pass;
+};
+
+/*
+ * The number of heap allocations made by the benchmarking thread so far.
+ */
+std::uint64_t allocationCount();
+
+/*
+ * Runs every benchmark whose name contains filter for at least minTime and
+ * writes a table with the time and allocations per operation and the
+ * throughput to output.
+ */
+void runBenchmarks(const std::vector<Benchmark>& benchmarks, std::chrono::milliseconds minTime, std::string_view filter, std::ostream& output);
+
+#endif
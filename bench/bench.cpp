@@ -0,0 +1,669 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include <ctre.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "../generator/FileBuffer.h"
+#include "../generator/FileQueue.h"
+#include "../generator/LaTeX.h"
+#include "../generator/OutputBuffer.h"
+#include "../generator/OutputFile.h"
+#include "../generator/Refpage.h"
+#include "../generator/RefpageSource.h"
+#include "../generator/TextScanner.h"
+#include "Benchmark.h"
+
+#ifndef GLWR_BENCH_FIXTURES
+#define GLWR_BENCH_FIXTURES "bench/fixtures/gl4"
+#endif
+
+/*
+ * Gives the benchmarks access to the parts of a refpage they measure.
+ */
+class RefpageBenchmark {
+
+public:
+	static void ParseText(Refpage& refpage, Node node, std::string& output) {
+		refpage.ParseText_(node, output);
+	}
+
+	/*
+	 * The regex based ParseText_ that the single pass scanner replaced, as a
+	 * baseline for it.
+	 */
+	static std::string ParseTextRegex(Refpage& refpage, Node para) {
+		constexpr ctll::fixed_string regexWhitespace = R"(\r?\n\s*)";
+		constexpr ctll::fixed_string regexSpaces = R"(^( *).*?( *)$)";
+		constexpr ctll::fixed_string regexTex = R"((\${1,2})([^$]+)(?:\1)(.*))";
+
+		std::stringstream ss;
+
+		for (const auto& [node, name, token] : NodeNameIterator(para)) {
+			std::string value = node.text().as_string();
+
+			if (token == XmlName::Text) {
+				auto result = ctre::search<regexWhitespace>(value);
+				bool hasWhitespace = result;
+
+				while (hasWhitespace) {
+					auto iter = value.erase(result.get<0>().begin(), result.get<0>().end());
+					value.insert(iter, ' ');
+
+					result = ctre::search<regexWhitespace>(value);
+					hasWhitespace = result;
+				}
+
+				ss << value;
+			} else {
+				std::string text;
+				refpage.ParseAbstractTextNode_(node, name, token, text);
+				ss << text;
+			}
+		}
+
+		std::string result = ss.str();
+		if (auto [found, begin, end] = ctre::match<regexSpaces>(result); found) {
+			result.erase(end.begin(), end.end());
+			result.erase(begin.begin(), begin.end());
+		}
+
+		std::string_view input = result;
+		std::stringstream output;
+
+		while (!input.empty()) {
+			auto [match, type, contents, rest] = ctre::search<regexTex>(input);
+
+			if (match) {
+				output << std::string_view(input.begin(), match.begin());
+				std::string text;
+				refpage.ParseLaTeX_(type, contents, text);
+				output << text;
+				input = rest;
+			} else {
+				output << input;
+				break;
+			}
+		}
+
+		return output.str();
+	}
+
+	static void GenerateText(const Refpage& refpage, std::ostream& output, std::string_view text) {
+		refpage.GenerateText_(output, text);
+	}
+
+	/*
+	 * The regex based GenerateText_ that the vectorized tokenizer replaced, as a
+	 * baseline for it.
+	 */
+	static void GenerateTextRegex(std::ostream& output, std::string_view text) {
+		constexpr ctll::fixed_string regexToken = R"(( *)([^\w< ]*(?:[\w'\-]+|<(code|sub|sup|i|b)>[^ <]{0,64}</\3>|<pre>.*?</pre>|<.*?>)?[^\w< \n]*)(.*))";
+
+		while (!text.empty() && *text.begin() == ' ') {
+			text = text.substr(1);
+		}
+
+		unsigned lineWidth = 0;
+
+		while (!text.empty()) {
+			if (*text.begin() == '\n') {
+				if (lineWidth == 0) {
+					output << "/// \n";
+				} else {
+					output << '\n';
+					lineWidth = 0;
+				}
+
+				text = text.substr(1);
+				continue;
+			}
+
+			const auto& [match, spacesMatch, tokenMatch, _, restMatch] = ctre::match<regexToken>(text);
+
+			if (!match) {
+				return;
+			}
+
+			std::string_view token = tokenMatch;
+			std::string_view spaces = spacesMatch;
+
+			if (!token.empty()) {
+				bool space = !spaces.empty();
+
+				if (lineWidth == 0) {
+					output << "///";
+					space = true;
+				} else if (lineWidth + token.length() + space > 77) {
+					output << '\n';
+					output << "///";
+					lineWidth = 0;
+					space = true;
+				}
+
+				if (space) {
+					output << ' ';
+				}
+
+				output << token;
+				lineWidth += token.length() + space;
+			}
+
+			text = restMatch;
+		}
+
+		if (lineWidth > 0) {
+			output << '\n';
+		}
+	}
+
+	static std::string_view ParseInnerLaTeX(Refpage& refpage, std::string_view input) {
+		return refpage.ParseInnerLaTeX_(input);
+	}
+
+	static void ParseProgramlisting(Refpage& refpage, Node node, std::string& output) {
+		refpage.ParseProgramlisting_(node, output);
+	}
+
+	static void ParseAbstractMathNode(Refpage& refpage, Node node, std::string_view name, XmlName token, std::string& output) {
+		refpage.ParseAbstractMathNode_(node, name, token, output);
+	}
+
+	static void ParseInlineequation(Refpage& refpage, Node node, std::string& output) {
+		refpage.ParseInlineequation_(node, output);
+	}
+
+};
+
+struct Fixture {
+	std::string name;
+	std::string source;
+	Document document;
+};
+
+static std::vector<std::unique_ptr<Fixture>> loadFixtures(const std::filesystem::path& dir) {
+	std::vector<std::unique_ptr<Fixture>> fixtures;
+
+	for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+		if (entry.path().extension() != ".xml") {
+			continue;
+		}
+
+		auto fixture = std::make_unique<Fixture>();
+		fixture->name = entry.path().stem().string();
+
+		FileBuffer buffer = FileBuffer::Map(entry.path());
+		fixture->source.assign(buffer.Data(), buffer.Size());
+		fixture->document.load_buffer(fixture->source.data(), fixture->source.size(), xmlParseOptions, pugi::encoding_utf8);
+
+		fixtures.push_back(std::move(fixture));
+	}
+
+	std::sort(fixtures.begin(), fixtures.end(), [](const auto& a, const auto& b) { return a->name < b->name; });
+	return fixtures;
+}
+
+/*
+ * Writes the fixtures into an uncompressed ustar archive, every one of them
+ * named with prefix before it, to check that the refpages are found in it.
+ */
+static void writeTar(const std::filesystem::path& path, const std::string& prefix, const std::vector<std::unique_ptr<Fixture>>& fixtures) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	for (const auto& fixture : fixtures) {
+		char header[512] = {};
+		std::string name = prefix + fixture->name + ".xml";
+
+		std::memcpy(header, name.data(), std::min<std::size_t>(name.size(), 99));
+		std::snprintf(header + 100, 8, "%07o", 0644);
+		std::snprintf(header + 124, 12, "%011llo", static_cast<unsigned long long>(fixture->source.size()));
+		std::memset(header + 148, ' ', 8);
+		header[156] = '0';
+		std::memcpy(header + 257, "ustar", 6);
+		std::memcpy(header + 263, "00", 2);
+
+		unsigned checksum = 0;
+		for (char c : header) {
+			checksum += static_cast<unsigned char>(c);
+		}
+
+		std::snprintf(header + 148, 8, "%06o", checksum);
+		file.write(header, sizeof(header));
+
+		file << fixture->source;
+		file << std::string((512 - fixture->source.size() % 512) % 512, '\0');
+	}
+
+	file << std::string(1024, '\0');
+}
+
+static void collectNodes(Node node, XmlName token, std::vector<Node>& nodes) {
+	for (const auto& [child, childName, childToken] : NodeNameIterator(node)) {
+		if (childToken == token) {
+			nodes.push_back(child);
+		}
+
+		collectNodes(child, token, nodes);
+	}
+}
+
+static std::uint64_t textSize(Node node) {
+	std::uint64_t size = std::strlen(node.value());
+
+	for (const auto& [child, name, token] : NodeNameIterator(node)) {
+		size += textSize(child);
+	}
+
+	return size;
+}
+
+static std::uint64_t textSize(const std::vector<Node>& nodes) {
+	std::uint64_t size = 0;
+
+	for (Node node : nodes) {
+		size += textSize(node);
+	}
+
+	return size;
+}
+
+template<typename T>
+static std::uint64_t stringSize(const std::vector<T>& strings) {
+	std::uint64_t size = 0;
+
+	for (const auto& str : strings) {
+		size += str.size();
+	}
+
+	return size;
+}
+
+int main(int argc, char* argv[]) {
+	std::filesystem::path fixturesDir = GLWR_BENCH_FIXTURES;
+	std::chrono::milliseconds minTime(500);
+	std::string filter;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		if (arg == "--fixtures" && i + 1 < argc) {
+			fixturesDir = argv[++i];
+		} else if (arg == "--min-time" && i + 1 < argc) {
+			minTime = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return -1;
+		}
+	}
+
+	// generate every documentation section; diagnostics are not interesting
+	include.Parse("11111111111");
+	std::ostream nowhere(nullptr);
+
+	auto fixtures = loadFixtures(fixturesDir);
+	if (fixtures.empty()) {
+		std::cerr << "No fixtures in " << fixturesDir << std::endl;
+		return -1;
+	}
+
+	std::vector<const Fixture*> pages;
+	std::vector<Node> paras, programlistings, maths, mathNodes;
+
+	for (const auto& fixture : fixtures) {
+		if (ctre::match<"gl[A-Z]\\w*">(fixture->name)) {
+			pages.push_back(fixture.get());
+		}
+
+		collectNodes(fixture->document, XmlName::Para, paras);
+		collectNodes(fixture->document, XmlName::Programlisting, programlistings);
+
+		std::size_t mathBegin = maths.size();
+		collectNodes(fixture->document, XmlName::MmlMath, maths);
+
+		for (std::size_t i = mathBegin; i < maths.size(); i++) {
+			for (const auto& [node, name, token] : NodeNameIterator(maths[i])) {
+				mathNodes.push_back(node);
+			}
+		}
+	}
+
+	// the refpage that the helpers are called on
+	RefpageSource refpages(fixturesDir);
+
+	// An archive can hold the gl4 directory, in a directory or not, or just
+	// its contents, and the same pages are read from all of them.
+	std::filesystem::path archive = std::filesystem::temp_directory_path() / "glwr-bench.tar";
+
+	for (const char* prefix : { "OpenGL-Refpages-main/gl4/", "gl4/", "", "./" }) {
+		writeTar(archive, prefix, fixtures);
+		bool same = false;
+
+		try {
+			RefpageSource archived(archive);
+			same = archived.Pages() == refpages.Pages();
+
+			for (const auto& fixture : fixtures) {
+				FileBuffer buffer = archived.Map(fixture->name + ".xml");
+				same = same && std::string_view(buffer.Data(), buffer.Size()) == fixture->source;
+			}
+		} catch (const std::runtime_error& error) {
+			std::cerr << error.what() << std::endl;
+		}
+
+		if (!same) {
+			std::cerr << "The refpages in an archive with \"" << prefix << "\" before them differ from the fixtures" << std::endl;
+			return -1;
+		}
+	}
+
+	std::filesystem::remove(archive);
+	std::string firstSource = pages.front()->source;
+	Refpage refpage(refpages, firstSource, pages.front()->name, nowhere);
+
+	// A section that is left out ends at its own close tag, not at one in a
+	// comment or character data in it.
+	{
+		std::string source = pages.front()->source;
+		std::size_t section = source.find("<refsect1 xml:id=\"description\">");
+
+		if (section == std::string::npos) {
+			std::cerr << "The first page of the fixtures has no description" << std::endl;
+			return -1;
+		}
+
+		std::string commented = source;
+		commented.insert(commented.find('>', section) + 1, "<!-- </refsect1> --><![CDATA[</refsect1>]]>");
+
+		include.Parse("11101111111");
+		OutputBuffer expected;
+		OutputBuffer actual;
+		Refpage(refpages, source, pages.front()->name, nowhere).GenerateHeader(expected);
+		Refpage(refpages, commented, pages.front()->name, nowhere).GenerateHeader(actual);
+		include.Parse("11111111111");
+
+		if (actual.View() != expected.View()) {
+			std::cerr << "A close tag in a comment in a left out section ends the section" << std::endl;
+			return -1;
+		}
+	}
+
+	// the rendered paragraphs are the input of the word wrapper, and contain
+	// the LaTeX expressions
+	std::vector<std::string> texts;
+	std::vector<std::string> latex;
+
+	for (Node para : paras) {
+		RefpageBenchmark::ParseText(refpage, para, texts.emplace_back());
+
+		if (texts.back() != RefpageBenchmark::ParseTextRegex(refpage, para)) {
+			std::cerr << "ParseText_ and its regex baseline differ on a paragraph of the fixtures" << std::endl;
+			return -1;
+		}
+
+		for (const auto& [node, name, token] : NodeNameIterator(para)) {
+			std::string_view text = node.value();
+
+			while (auto match = ctre::search<R"((\${1,2})([^$]+)\1)">(text)) {
+				latex.emplace_back(match.get<2>());
+				text = std::string_view(match.get<0>().end(), text.end());
+			}
+		}
+	}
+
+	for (const auto& text : texts) {
+		for (ScanLevel level : { ScanLevel::Scalar, maxScanLevel() }) {
+			std::stringstream output;
+			std::stringstream baseline;
+
+			setScanLevel(level);
+			RefpageBenchmark::GenerateText(refpage, output, text);
+			RefpageBenchmark::GenerateTextRegex(baseline, text);
+
+			if (output.str() != baseline.str()) {
+				std::cerr << "GenerateText_ and its regex baseline differ on a paragraph of the fixtures" << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	setScanLevel(maxScanLevel());
+
+	std::uint64_t pagesSize = 0;
+	for (const Fixture* page : pages) {
+		pagesSize += page->source.size();
+	}
+
+	// the parsed pages and their headers, to measure emitting and writing
+	std::vector<Refpage> models;
+	std::vector<std::string> headers;
+
+	for (const Fixture* page : pages) {
+		std::string source = page->source;
+		Refpage& model = models.emplace_back(refpages, source, page->name, nowhere);
+
+		OutputBuffer header;
+		model.GenerateHeader(header);
+		headers.emplace_back(header.View());
+	}
+
+	std::filesystem::path scratch = std::filesystem::temp_directory_path() / "glwr-bench.h";
+	std::filesystem::path scratchDir = std::filesystem::temp_directory_path() / "glwr-bench-headers";
+	std::filesystem::create_directories(scratchDir);
+
+	std::vector<Benchmark> benchmarks;
+
+	benchmarks.push_back({ "ParseText_", paras.size(), textSize(paras), [&]() {
+		std::string output;
+
+		for (Node para : paras) {
+			output.clear();
+			RefpageBenchmark::ParseText(refpage, para, output);
+		}
+	} });
+
+	benchmarks.push_back({ "ParseText_ (regex)", paras.size(), textSize(paras), [&]() {
+		for (Node para : paras) {
+			RefpageBenchmark::ParseTextRegex(refpage, para);
+		}
+	} });
+
+	// the word wrapper, with every instruction set the CPU supports
+	constexpr std::pair<ScanLevel, const char*> scanLevels[] = {
+			{ ScanLevel::Avx2, "GenerateText_ (avx2)" },
+			{ ScanLevel::Sse2, "GenerateText_ (sse2)" },
+			{ ScanLevel::Scalar, "GenerateText_ (scalar)" }
+	};
+
+	for (const auto& [level, name] : scanLevels) {
+		if (level > maxScanLevel()) {
+			continue;
+		}
+
+		benchmarks.push_back({ name, texts.size(), stringSize(texts), [&, level]() {
+			setScanLevel(level);
+			OutputBuffer output;
+
+			for (const auto& text : texts) {
+				output.Clear();
+				RefpageBenchmark::GenerateText(refpage, output, text);
+			}
+
+			setScanLevel(maxScanLevel());
+		} });
+	}
+
+	// the wrapper alone, from the tokens that the model stores
+	std::vector<TextTokens> tokens(texts.size());
+	for (std::size_t i = 0; i < texts.size(); i++) {
+		tokenizeText(texts[i], tokens[i]);
+	}
+
+	benchmarks.push_back({ "wrapTokens", texts.size(), stringSize(texts), [&]() {
+		OutputBuffer output;
+
+		for (std::size_t i = 0; i < texts.size(); i++) {
+			output.Clear();
+			wrapTokens(output, texts[i], tokens[i]);
+		}
+	} });
+
+	benchmarks.push_back({ "GenerateText_ (regex)", texts.size(), stringSize(texts), [&]() {
+		OutputBuffer output;
+
+		for (const auto& text : texts) {
+			output.Clear();
+			RefpageBenchmark::GenerateTextRegex(output, text);
+		}
+	} });
+
+	benchmarks.push_back({ "ParseInnerLaTeX_", latex.size(), stringSize(latex), [&]() {
+		for (const auto& expression : latex) {
+			RefpageBenchmark::ParseInnerLaTeX(refpage, expression);
+		}
+	} });
+
+	// the renderer behind the memo, for fragments that are new
+	benchmarks.push_back({ "renderLaTeX", latex.size(), stringSize(latex), [&]() {
+		for (const auto& expression : latex) {
+			renderLaTeX(expression);
+		}
+	} });
+
+	benchmarks.push_back({ "ParseProgramlisting_", programlistings.size(), textSize(programlistings), [&]() {
+		std::string output;
+
+		for (Node programlisting : programlistings) {
+			output.clear();
+			RefpageBenchmark::ParseProgramlisting(refpage, programlisting, output);
+		}
+	} });
+
+	benchmarks.push_back({ "ParseMml*_", mathNodes.size(), textSize(mathNodes), [&]() {
+		std::string output;
+
+		for (Node node : mathNodes) {
+			output.clear();
+			RefpageBenchmark::ParseAbstractMathNode(refpage, node, node.name(), xmlName(node.name()), output);
+		}
+	} });
+
+	benchmarks.push_back({ "ParseInlineequation_", maths.size(), textSize(maths), [&]() {
+		std::string output;
+
+		for (Node math : maths) {
+			output.clear();
+			RefpageBenchmark::ParseInlineequation(refpage, math.parent(), output);
+		}
+	} });
+
+	benchmarks.push_back({ "Emit (stringstream)", models.size(), stringSize(headers), [&]() {
+		for (const auto& model : models) {
+			std::stringstream output;
+			model.GenerateHeader(output);
+			output.str();
+		}
+	} });
+
+	benchmarks.push_back({ "Emit (OutputBuffer)", models.size(), stringSize(headers), [&]() {
+		OutputBuffer output;
+
+		for (const auto& model : models) {
+			output.Clear();
+			model.GenerateHeader(output);
+		}
+	} });
+
+	// what writing a header used to be: a flush, and so a write, for every line
+	benchmarks.push_back({ "Write (std::endl per line)", headers.size(), stringSize(headers), [&]() {
+		for (const auto& header : headers) {
+			std::ofstream file(scratch, std::ios::trunc);
+			std::string_view lines = header;
+
+			while (!lines.empty()) {
+				auto end = lines.find('\n');
+				file << lines.substr(0, end) << std::endl;
+				lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 1);
+			}
+		}
+	} });
+
+	benchmarks.push_back({ "Write (single write)", headers.size(), stringSize(headers), [&]() {
+		for (const auto& header : headers) {
+			std::ofstream file(scratch, std::ios::binary | std::ios::trunc);
+			file.write(header.data(), static_cast<std::streamsize>(header.size()));
+		}
+	} });
+
+	// Every header replaced the way the generator does it, on the generating
+	// thread and through the file queue. Every round writes each file with the
+	// header of its neighbour, so that none of them is unchanged.
+	std::size_t round = 0;
+
+	benchmarks.push_back({ "Write (replaceFileIfChanged)", headers.size(), stringSize(headers), [&]() {
+		round++;
+
+		for (std::size_t i = 0; i < headers.size(); i++) {
+			replaceFileIfChanged(scratchDir / (std::to_string(i) + ".h"), headers[(i + round) % headers.size()]);
+		}
+	} });
+
+	constexpr std::pair<bool, const char*> fileQueues[] = {
+			{ true, "Write (FileQueue, io_uring)" },
+			{ false, "Write (FileQueue, threads)" }
+	};
+
+	for (const auto& [ioUring, name] : fileQueues) {
+		benchmarks.push_back({ name, headers.size(), stringSize(headers), [&, ioUring]() {
+			FileQueue files(ioUring, 4);
+			round++;
+
+			for (std::size_t i = 0; i < headers.size(); i++) {
+				files.Write(scratchDir / (std::to_string(i) + ".h"), headers[(i + round) % headers.size()]);
+			}
+
+			files.Flush();
+		} });
+	}
+
+	// the input is parsed in place, so every operation includes a copy of it
+	benchmarks.push_back({ "Page (parse + emit)", pages.size(), pagesSize, [&]() {
+		for (const Fixture* page : pages) {
+			std::string source = page->source;
+			Refpage pageRefpage(refpages, source, page->name, nowhere);
+
+			std::stringstream output;
+			pageRefpage.GenerateHeader(output);
+		}
+	} });
+
+	// the same with the default options, where the pages are loaded without
+	// the sections that are left out
+	benchmarks.push_back({ "Page (default options)", pages.size(), pagesSize, [&]() {
+		include.Parse("11100011001");
+
+		for (const Fixture* page : pages) {
+			std::string source = page->source;
+			Refpage pageRefpage(refpages, source, page->name, nowhere);
+
+			std::stringstream output;
+			pageRefpage.GenerateHeader(output);
+		}
+
+		include.Parse("11111111111");
+	} });
+
+	runBenchmarks(benchmarks, minTime, filter, std::cout);
+	std::filesystem::remove(scratch);
+	std::filesystem::remove_all(scratchDir);
+	return 0;
+}
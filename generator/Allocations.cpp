@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// Count the allocations of the pages that stats are recorded for, by replacing
+// the global operator new of the generator. Without stats, the only cost is
+// checking pageStats. The array and nothrow versions forward to these.
+void* operator new(std::size_t size) {
+	if (pageStats) {
+		pageStats->allocations++;
+	}
+
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	if (pageStats) {
+		pageStats->allocations++;
+	}
+
+	// the size of an aligned allocation is a multiple of its alignment
+	auto align = static_cast<std::size_t>(alignment);
+	size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+
+#ifdef _WIN32
+	void* ptr = _aligned_malloc(size, align);
+#else
+	void* ptr = std::aligned_alloc(align, size);
+#endif
+
+	if (ptr) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+	operator delete(ptr, alignment);
+}
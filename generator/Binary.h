@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_BINARY_H
+#define GLWR_BINARY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Writes numbers (as LEB128 varints) and length-prefixed strings into a
+ * contiguous buffer.
+ */
+class BinaryWriter {
+
+public:
+	void WriteNumber(std::uint64_t value) {
+		do {
+			auto byte = static_cast<unsigned char>(value & 0x7f);
+			value >>= 7;
+
+			if (value != 0) {
+				byte |= 0x80;
+			}
+
+			_data.push_back(static_cast<char>(byte));
+		} while (value != 0);
+	}
+
+	void WriteBool(bool value) {
+		WriteNumber(value ? 1 : 0);
+	}
+
+	void WriteString(std::string_view value) {
+		WriteNumber(value.size());
+		_data.append(value);
+	}
+
+	void WriteRaw(std::string_view value) {
+		_data.append(value);
+	}
+
+	const std::string& Data() const {
+		return _data;
+	}
+
+private:
+	std::string _data;
+
+};
+
+/*
+ * Reads what a BinaryWriter wrote. Reading past the end of the data, or
+ * reading malformed data, sets the failed flag and returns empty values.
+ */
+class BinaryReader {
+
+public:
+	explicit BinaryReader(std::string_view data) :
+			_data(data) {}
+
+	std::uint64_t ReadNumber() {
+		std::uint64_t value = 0;
+
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			if (_data.empty()) {
+				break;
+			}
+
+			auto byte = static_cast<unsigned char>(_data.front());
+			_data.remove_prefix(1);
+			value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+
+		_failed = true;
+		return 0;
+	}
+
+	bool ReadBool() {
+		return ReadNumber() != 0;
+	}
+
+	std::string_view ReadString() {
+		return ReadRaw(ReadNumber());
+	}
+
+	std::string_view ReadRaw(std::uint64_t size) {
+		if (_failed || size > _data.size()) {
+			_failed = true;
+			return {};
+		}
+
+		std::string_view value = _data.substr(0, size);
+		_data.remove_prefix(size);
+		return value;
+	}
+
+	/*
+	 * Sets the failed flag, for data that was read fine but doesn't make
+	 * sense.
+	 */
+	void Fail() {
+		_failed = true;
+	}
+
+	bool Failed() const {
+		return _failed;
+	}
+
+	bool AtEnd() const {
+		return _data.empty();
+	}
+
+private:
+	std::string_view _data;
+	bool _failed = false;
+
+};
+
+#endif
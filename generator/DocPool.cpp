@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "DocPool.h"
+
+const DocPool::Block* DocPool::Get(std::string_view source, const Renderer& render) {
+	return _blocks.Get(source, [&](std::uint64_t hash, Block& block) {
+		block.hash = hash;
+		render(source, block);
+	});
+}
+
+const DocPool::Block* DocPool::Find(std::uint64_t hash) const {
+	return _blocks.Find(hash);
+}
+
+void DocPool::Retain(const std::unordered_set<std::uint64_t>& used) {
+	_blocks.Retain([&](std::uint64_t hash) {
+		return used.contains(hash);
+	});
+}
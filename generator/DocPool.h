@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_DOCPOOL_H
+#define GLWR_DOCPOOL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "HashMemo.h"
+
+/*
+ * The start of a line that refers to a block in the shared docs header. It is
+ * followed by the hash of the block, as a string.
+ */
+constexpr std::string_view docReferencePrefix = "/// \\copydoc GLWR_DOC_";
+
+/*
+ * A process-wide pool of rendered blocks of documentation text, addressed by
+ * the hash of their source text.
+ * Many paragraphs (copyright notices, common errors) are the same on many
+ * refpages. Each of them is rendered once per run, however many headers it
+ * ends up in. The pool can be used from multiple threads.
+ */
+class DocPool {
+
+public:
+	struct Block {
+		// the hash of the source text, which identifies the block
+		std::uint64_t hash = 0;
+
+		// the rendered block
+		std::string text;
+
+		// the source text that could not be rendered, if rendering failed
+		std::string failed;
+	};
+
+	using Renderer = std::function<void(std::string_view, Block&)>;
+
+	/*
+	 * Returns the block for source. If it is not in the pool, render is called
+	 * to fill it in. Returns nullptr if a different source with the same hash
+	 * is already in the pool, in which case the caller renders it itself.
+	 */
+	const Block* Get(std::string_view source, const Renderer& render);
+
+	/*
+	 * Returns the block with the given hash, or nullptr if there is none.
+	 */
+	const Block* Find(std::uint64_t hash) const;
+
+	/*
+	 * Drops every block whose hash is not in used, e.g. the blocks of
+	 * paragraphs that have been edited since. No pointer to a dropped block
+	 * may be in use.
+	 */
+	void Retain(const std::unordered_set<std::uint64_t>& used);
+
+	std::size_t Hits() const { return _blocks.Hits(); }
+	std::size_t Misses() const { return _blocks.Misses(); }
+
+private:
+	HashMemo<Block> _blocks;
+
+};
+
+inline DocPool docPool;
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "FileBuffer.h"
+
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GLWR_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileBuffer::~FileBuffer() {
+	Release_();
+}
+
+FileBuffer::FileBuffer(FileBuffer&& buffer) noexcept :
+		_data(std::exchange(buffer._data, nullptr)),
+		_size(std::exchange(buffer._size, 0)),
+		_mapping(std::exchange(buffer._mapping, nullptr)),
+		_mappingSize(std::exchange(buffer._mappingSize, 0)),
+		_heap(std::move(buffer._heap)) {}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& buffer) noexcept {
+	if (this != &buffer) {
+		Release_();
+
+		_data = std::exchange(buffer._data, nullptr);
+		_size = std::exchange(buffer._size, 0);
+		_mapping = std::exchange(buffer._mapping, nullptr);
+		_mappingSize = std::exchange(buffer._mappingSize, 0);
+		_heap = std::move(buffer._heap);
+	}
+
+	return *this;
+}
+
+FileBuffer FileBuffer::Map(const std::filesystem::path& path) {
+#ifdef GLWR_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return FileBuffer();
+	}
+
+	FileBuffer buffer;
+
+	struct stat st{};
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		buffer = Map_(fd, 0, static_cast<std::size_t>(st.st_size));
+	}
+
+	close(fd);
+
+	if (buffer._mapping) {
+		return buffer;
+	}
+#endif
+
+	return Read_(path, 0, std::nullopt);
+}
+
+FileBuffer FileBuffer::Map(const std::filesystem::path& path, std::uint64_t offset, std::size_t size) {
+	if (size == 0) {
+		return FileBuffer();
+	}
+
+#ifdef GLWR_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return FileBuffer();
+	}
+
+	FileBuffer buffer = Map_(fd, offset, size);
+	close(fd);
+
+	if (buffer._mapping) {
+		return buffer;
+	}
+#endif
+
+	return Read_(path, offset, size);
+}
+
+FileBuffer FileBuffer::Read(const std::filesystem::path& path) {
+	return Read_(path, 0, std::nullopt);
+}
+
+FileBuffer FileBuffer::Map_(int fd, std::uint64_t offset, std::size_t size) {
+	FileBuffer buffer;
+
+#ifdef GLWR_MMAP
+	// The offset of a mapping must be a multiple of the page size, so map from
+	// the start of the page the range begins in.
+	static const auto pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+	std::uint64_t start = offset - offset % pageSize;
+	std::size_t mappingSize = size + static_cast<std::size_t>(offset - start);
+
+	// A private mapping can be written to without changing the file, which is
+	// what in-place parsing needs.
+	void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(start));
+
+	if (mapping != MAP_FAILED) {
+		madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+		buffer._mapping = mapping;
+		buffer._mappingSize = mappingSize;
+		buffer._data = static_cast<char*>(mapping) + (offset - start);
+		buffer._size = size;
+	}
+#endif
+
+	return buffer;
+}
+
+FileBuffer FileBuffer::Read_(const std::filesystem::path& path, std::uint64_t offset, std::optional<std::size_t> size) {
+	FileBuffer buffer;
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return buffer;
+	}
+
+	auto fileSize = static_cast<std::uint64_t>(file.tellg());
+	if (offset >= fileSize) {
+		return buffer;
+	}
+
+	std::size_t readSize = size.value_or(static_cast<std::size_t>(fileSize - offset));
+	file.seekg(static_cast<std::streamoff>(offset));
+
+	buffer._heap = std::make_unique<char[]>(readSize);
+	file.read(buffer._heap.get(), static_cast<std::streamsize>(readSize));
+
+	buffer._data = buffer._heap.get();
+	buffer._size = static_cast<std::size_t>(file.gcount());
+	return buffer;
+}
+
+void FileBuffer::Release_() {
+#ifdef GLWR_MMAP
+	if (_mapping) {
+		munmap(_mapping, _mappingSize);
+	}
+#endif
+
+	_mapping = nullptr;
+	_mappingSize = 0;
+	_heap.reset();
+	_data = nullptr;
+	_size = 0;
+}
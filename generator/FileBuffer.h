@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_FILEBUFFER_H
+#define GLWR_FILEBUFFER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+
+/*
+ * The writable contents of a file. Where possible, the file is mapped into
+ * memory copy-on-write, so it can be parsed in place without a heap copy of the
+ * file contents. Writes to the buffer never reach the file itself.
+ */
+class FileBuffer {
+
+public:
+	FileBuffer() = default;
+	~FileBuffer();
+
+	FileBuffer(FileBuffer&& buffer) noexcept;
+	FileBuffer& operator=(FileBuffer&& buffer) noexcept;
+
+	/*
+	 * Maps the file at path. If the file cannot be opened, the returned buffer
+	 * is empty.
+	 */
+	static FileBuffer Map(const std::filesystem::path& path);
+
+	/*
+	 * Maps size bytes at offset of the file at path, e.g. an entry of an
+	 * archive. Every mapping of a range is a separate copy-on-write view, so
+	 * writing to one doesn't change any other buffer of the same range.
+	 */
+	static FileBuffer Map(const std::filesystem::path& path, std::uint64_t offset, std::size_t size);
+
+	/*
+	 * Reads the file at path into memory, for a file that may be rewritten
+	 * while the buffer is in use, which would take a mapping of it away. If the
+	 * file cannot be opened, the returned buffer is empty.
+	 */
+	static FileBuffer Read(const std::filesystem::path& path);
+
+	char* Data() { return _data; }
+	const char* Data() const { return _data; }
+	std::size_t Size() const { return _size; }
+
+	std::span<char> Span() { return { _data, _size }; }
+
+private:
+	static FileBuffer Map_(int fd, std::uint64_t offset, std::size_t size);
+	static FileBuffer Read_(const std::filesystem::path& path, std::uint64_t offset, std::optional<std::size_t> size);
+
+	void Release_();
+
+	char* _data = nullptr;
+	std::size_t _size = 0;
+
+	void* _mapping = nullptr;
+	std::size_t _mappingSize = 0;
+	std::unique_ptr<char[]> _heap;
+
+};
+
+#endif
@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "FileQueue.h"
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define GLWR_IO_URING
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// the number of requests the ring handles at once. A write takes three
+// entries of the ring.
+constexpr static std::size_t ringBatch = 32;
+
+#ifdef GLWR_IO_URING
+
+constexpr static unsigned ringEntries = 128;
+
+/*
+ * A minimal io_uring: a submission queue and a completion queue shared with
+ * the kernel. Entries are filled in with Next() and submitted together.
+ */
+struct FileQueue::Ring {
+	~Ring() {
+		if (sqes) {
+			munmap(sqes, sqesSize);
+		}
+
+		if (cqRing && cqRing != sqRing) {
+			munmap(cqRing, cqRingSize);
+		}
+
+		if (sqRing) {
+			munmap(sqRing, sqRingSize);
+		}
+
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+
+	// Sets up the ring. Returns false if the system doesn't support io_uring,
+	// or any of the operations the queue uses.
+	bool Setup() {
+		io_uring_params params{};
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &params));
+
+		if (fd < 0 || !Supports_()) {
+			return false;
+		}
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+		// newer kernels map both queues at once
+		if (params.features & IORING_FEAT_SINGLE_MMAP) {
+			sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+		}
+
+		sqRing = Map_(sqRingSize, IORING_OFF_SQ_RING);
+		cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing : Map_(cqRingSize, IORING_OFF_CQ_RING);
+		sqes = static_cast<io_uring_sqe*>(Map_(sqesSize, IORING_OFF_SQES));
+
+		if (!sqRing || !cqRing || !sqes) {
+			return false;
+		}
+
+		auto* sq = static_cast<char*>(sqRing);
+		auto* cq = static_cast<char*>(cqRing);
+
+		sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		return true;
+	}
+
+	// Returns the next entry of the submission queue, cleared.
+	io_uring_sqe& Next() {
+		unsigned index = (*sqTail + queued++) & sqMask;
+		sqArray[index] = index;
+
+		io_uring_sqe& sqe = sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		return sqe;
+	}
+
+	// Submits the entries, and waits for all of them to complete. Calls
+	// complete with the user data and result of each. Throws if the ring
+	// fails, after which Drain() waits for the entries it already took.
+	template<typename F>
+	void Submit(const F& complete) {
+		unsigned submit = std::exchange(queued, 0);
+		std::atomic_ref(*sqTail).store(*sqTail + submit, std::memory_order_release);
+
+		while (submit > 0 || inflight > 0) {
+			int result = static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, submit + inflight, IORING_ENTER_GETEVENTS, nullptr, 0));
+
+			if (result < 0 && errno != EINTR) {
+				throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+			}
+
+			if (result > 0) {
+				unsigned submitted = std::min(submit, static_cast<unsigned>(result));
+				submit -= submitted;
+				inflight += submitted;
+			}
+
+			Reap_(complete);
+		}
+	}
+
+	// Waits for the entries that were submitted to complete, without
+	// submitting any more. Returns false if the ring fails again.
+	template<typename F>
+	bool Drain(const F& complete) {
+		Reap_(complete);
+
+		while (inflight > 0) {
+			if (syscall(__NR_io_uring_enter, fd, 0, inflight, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+				return false;
+			}
+
+			Reap_(complete);
+		}
+
+		return true;
+	}
+
+	bool Run(const std::vector<Request>& requests, std::exception_ptr& error);
+
+	int fd = -1;
+	unsigned queued = 0;
+
+	// the entries the kernel took that did not complete yet
+	unsigned inflight = 0;
+
+	void* sqRing = nullptr;
+	void* cqRing = nullptr;
+	io_uring_sqe* sqes = nullptr;
+	std::size_t sqRingSize = 0;
+	std::size_t cqRingSize = 0;
+	std::size_t sqesSize = 0;
+
+	unsigned* sqTail = nullptr;
+	unsigned* sqArray = nullptr;
+	unsigned sqMask = 0;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned cqMask = 0;
+	io_uring_cqe* cqes = nullptr;
+
+private:
+	template<typename F>
+	void Reap_(const F& complete) {
+		unsigned head = *cqHead;
+		unsigned tail = std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+
+		for (; head != tail; head++, inflight--) {
+			const io_uring_cqe& cqe = cqes[head & cqMask];
+			complete(cqe.user_data, cqe.res);
+		}
+
+		std::atomic_ref(*cqHead).store(head, std::memory_order_release);
+	}
+
+	void* Map_(std::size_t size, std::uint64_t offset) const {
+		void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, static_cast<off_t>(offset));
+		return mapping == MAP_FAILED ? nullptr : mapping;
+	}
+
+	bool Supports_() const {
+		constexpr unsigned opCount = 256;
+		std::vector<unsigned char> buffer(sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op));
+		auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+		if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, opCount) < 0) {
+			return false;
+		}
+
+		for (unsigned op : { IORING_OP_OPENAT, IORING_OP_FADVISE, IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_RENAMEAT }) {
+			if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+};
+
+bool FileQueue::Ring::Run(const std::vector<Request>& requests, std::exception_ptr& error) {
+	struct File {
+		std::string temporary;
+		int fd = -1;
+		bool skip = false;
+		bool closing = false;
+		bool closed = false;
+		bool failed = false;
+	};
+
+	std::vector<File> files(requests.size());
+
+	auto opened = [&](std::uint64_t data, int result) {
+		files[data].fd = result;
+	};
+
+	auto chained = [&](std::uint64_t data, int result) {
+		File& file = files[data / 3];
+
+		switch (data % 3) {
+			case 0:
+				// a short write also breaks the chain
+				file.failed = file.failed || result < 0 || (requests[data / 3].write && static_cast<std::size_t>(result) != requests[data / 3].contents.size());
+				break;
+			case 1:
+				file.closed = result != -ECANCELED;
+				file.failed = file.failed || result < 0;
+				break;
+			default:
+				file.failed = file.failed || result < 0;
+				break;
+		}
+	};
+
+	bool chaining = false;
+	bool broken = false;
+
+	try {
+		// open every file at once, skipping headers that didn't change
+		for (std::size_t i = 0; i < requests.size(); i++) {
+			const Request& request = requests[i];
+			File& file = files[i];
+
+			if (request.write && fileHasContents(request.path, request.contents)) {
+				file.skip = true;
+				continue;
+			}
+
+			io_uring_sqe& sqe = Next();
+			sqe.opcode = IORING_OP_OPENAT;
+			sqe.fd = AT_FDCWD;
+			sqe.user_data = i;
+
+			if (request.write) {
+				file.temporary = request.path + ".tmp";
+				sqe.addr = reinterpret_cast<std::uint64_t>(file.temporary.c_str());
+				sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+				sqe.len = 0666;
+			} else {
+				sqe.addr = reinterpret_cast<std::uint64_t>(request.path.c_str());
+				sqe.open_flags = O_RDONLY | O_CLOEXEC;
+			}
+		}
+
+		Submit(opened);
+		chaining = true;
+
+		// Then write, close and rename every header in one chain, or read
+		// ahead and close. The rest of a chain is cancelled if a step of it
+		// fails.
+		for (std::size_t i = 0; i < requests.size(); i++) {
+			const Request& request = requests[i];
+			File& file = files[i];
+
+			if (file.fd < 0) {
+				continue;
+			}
+
+			io_uring_sqe& first = Next();
+			first.fd = file.fd;
+			first.flags = IOSQE_IO_LINK;
+			first.user_data = 3 * i;
+
+			if (request.write) {
+				first.opcode = IORING_OP_WRITE;
+				first.addr = reinterpret_cast<std::uint64_t>(request.contents.data());
+				first.len = static_cast<unsigned>(request.contents.size());
+			} else {
+				first.opcode = IORING_OP_FADVISE;
+				first.fadvise_advice = POSIX_FADV_WILLNEED;
+			}
+
+			io_uring_sqe& close = Next();
+			close.opcode = IORING_OP_CLOSE;
+			close.fd = file.fd;
+			close.user_data = 3 * i + 1;
+			file.closing = true;
+
+			if (request.write) {
+				close.flags = IOSQE_IO_LINK;
+
+				io_uring_sqe& rename = Next();
+				rename.opcode = IORING_OP_RENAMEAT;
+				rename.fd = AT_FDCWD;
+				rename.addr = reinterpret_cast<std::uint64_t>(file.temporary.c_str());
+				rename.len = static_cast<unsigned>(AT_FDCWD);
+				rename.addr2 = reinterpret_cast<std::uint64_t>(request.path.c_str());
+				rename.user_data = 3 * i + 2;
+			}
+		}
+
+		Submit(chained);
+	} catch (...) {
+		// Wait for what the kernel already took, so that nothing refers to the
+		// batch anymore. If that fails too, a close that may have run is not
+		// done again, as the descriptor could be reused by then.
+		bool drained = chaining ? Drain(chained) : Drain(opened);
+
+		for (File& file : files) {
+			if (file.fd >= 0 && !file.closed && (drained || !file.closing)) {
+				::close(file.fd);
+			}
+		}
+
+		// every write is done again the usual way, which skips the ones
+		// that did make it
+		for (std::size_t i = 0; i < requests.size(); i++) {
+			files[i].fd = -1;
+			files[i].failed = true;
+		}
+
+		broken = true;
+	}
+
+	// Writes that failed are done again the usual way, which reports the
+	// error. A failed read ahead doesn't matter.
+	for (std::size_t i = 0; i < requests.size(); i++) {
+		const Request& request = requests[i];
+		File& file = files[i];
+
+		if (file.fd >= 0 && !file.closed) {
+			::close(file.fd);
+		}
+
+		if (request.write && !file.skip && (file.fd < 0 || file.failed)) {
+			try {
+				replaceFileIfChanged(request.path, request.contents);
+			} catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	}
+
+	return !broken;
+}
+
+#else
+
+struct FileQueue::Ring {};
+
+#endif
+
+FileQueue::FileQueue(bool ioUring, unsigned threads) {
+#ifdef GLWR_IO_URING
+	if (ioUring) {
+		auto ring = std::make_unique<Ring>();
+
+		if (ring->Setup()) {
+			_ring = std::move(ring);
+			_backend = Backend::IoUring;
+			_threads.emplace_back(&FileQueue::RingLoop_, this);
+			return;
+		}
+	}
+#endif
+
+	for (unsigned i = 0; i < std::max(threads, 1u); i++) {
+		_threads.emplace_back(&FileQueue::ThreadLoop_, this);
+	}
+}
+
+FileQueue::~FileQueue() {
+	{
+		std::lock_guard lock(_mutex);
+		_stop = true;
+	}
+
+	_available.notify_all();
+
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+void FileQueue::Prefetch(const std::filesystem::path& path) {
+	Push_({ false, path.string(), {} });
+}
+
+void FileQueue::Write(const std::filesystem::path& path, std::string contents) {
+	Push_({ true, path.string(), std::move(contents) });
+}
+
+void FileQueue::Flush() {
+	std::unique_lock lock(_mutex);
+	_done.wait(lock, [&]() { return _pending == 0; });
+
+	if (_error) {
+		std::rethrow_exception(std::exchange(_error, nullptr));
+	}
+}
+
+void FileQueue::Push_(Request request) {
+	bool wake;
+
+	// Only a queue that was empty has to wake a thread up. The requests that
+	// come in while it works are taken by it, or by the next thread it wakes.
+	{
+		std::lock_guard lock(_mutex);
+		wake = _requests.empty();
+		_requests.push_back(std::move(request));
+		_pending++;
+	}
+
+	if (wake) {
+		_available.notify_one();
+	}
+}
+
+bool FileQueue::Take_(std::vector<Request>& requests, std::size_t max) {
+	std::unique_lock lock(_mutex);
+	_available.wait(lock, [&]() { return _stop || !_requests.empty(); });
+
+	// the requests that are left are handled before stopping
+	if (_requests.empty()) {
+		return false;
+	}
+
+	requests.clear();
+
+	while (!_requests.empty() && requests.size() < max) {
+		requests.push_back(std::move(_requests.front()));
+		_requests.pop_front();
+	}
+
+	if (!_requests.empty()) {
+		_available.notify_one();
+	}
+
+	return true;
+}
+
+void FileQueue::Done_(std::size_t count, std::exception_ptr error) {
+	{
+		std::lock_guard lock(_mutex);
+		_pending -= count;
+
+		if (error && !_error) {
+			_error = error;
+		}
+	}
+
+	_done.notify_all();
+}
+
+void FileQueue::ThreadLoop_() {
+	std::vector<Request> requests;
+
+	while (Take_(requests, 1)) {
+		std::exception_ptr error;
+
+		try {
+			Handle_(requests.front());
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		Done_(requests.size(), error);
+	}
+}
+
+void FileQueue::RingLoop_() {
+	std::vector<Request> requests;
+
+	// every round takes the requests that came in while the last one ran
+	while (Take_(requests, ringBatch)) {
+		std::exception_ptr error;
+		bool ring = true;
+
+		try {
+#ifdef GLWR_IO_URING
+			ring = _ring->Run(requests, error);
+#endif
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		// A ring that failed is not trusted again. Its batch was written the
+		// usual way, and the rest of the queue is left to threads.
+		if (!ring) {
+			_ring.reset();
+			_backend = Backend::Threads;
+		}
+
+		Done_(requests.size(), error);
+
+		if (!ring) {
+			ThreadLoop_();
+			return;
+		}
+	}
+}
+
+void FileQueue::Handle_(const Request& request) {
+	if (request.write) {
+		replaceFileIfChanged(request.path, request.contents);
+		return;
+	}
+
+#if defined(__unix__) && defined(POSIX_FADV_WILLNEED)
+	int fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+#endif
+}
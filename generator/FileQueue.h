@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_FILEQUEUE_H
+#define GLWR_FILEQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Reads and writes files in the background, so that generating the pages
+ * doesn't wait for the file system. Files that are needed soon are read into
+ * the page cache ahead of time, and the headers are written behind the
+ * generation, in batches.
+ * On Linux, the requests are submitted through io_uring. Where that is not
+ * available, a few threads handle them one at a time instead.
+ */
+class FileQueue {
+
+public:
+	enum class Backend {
+		IoUring,
+		Threads
+	};
+
+	/*
+	 * Starts the queue. With ioUring, io_uring is used if the system supports
+	 * it, otherwise threads background threads are.
+	 */
+	FileQueue(bool ioUring, unsigned threads);
+	~FileQueue();
+
+	FileQueue(const FileQueue&) = delete;
+	FileQueue& operator=(const FileQueue&) = delete;
+
+	/*
+	 * Starts reading the file at path, so that mapping it later doesn't have
+	 * to wait for the file system. Errors are ignored.
+	 */
+	void Prefetch(const std::filesystem::path& path);
+
+	/*
+	 * Replaces the file at path with contents in the background, unless it
+	 * already has exactly those contents, like replaceFileIfChanged.
+	 */
+	void Write(const std::filesystem::path& path, std::string contents);
+
+	/*
+	 * Blocks until all requests so far are done. Throws the error of the
+	 * first write that failed, if any.
+	 */
+	void Flush();
+
+	/*
+	 * Returns the backend that handles the requests now. A queue that started
+	 * on io_uring moves to a thread for good if the ring fails.
+	 */
+	Backend GetBackend() const { return _backend; }
+
+private:
+	struct Request {
+		bool write;
+		std::string path;
+		std::string contents;
+	};
+
+	struct Ring;
+
+	void Push_(Request request);
+	bool Take_(std::vector<Request>& requests, std::size_t max);
+	void Done_(std::size_t count, std::exception_ptr error);
+
+	void ThreadLoop_();
+	void RingLoop_();
+
+	static void Handle_(const Request& request);
+
+	std::atomic<Backend> _backend = Backend::Threads;
+	std::unique_ptr<Ring> _ring;
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _available;
+	std::condition_variable _done;
+	std::deque<Request> _requests;
+	std::size_t _pending = 0;
+	std::exception_ptr _error;
+	bool _stop = false;
+
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__) && __has_include(<sys/inotify.h>)
+#define GLWR_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+constexpr static std::chrono::milliseconds forever(-1);
+
+// how often the directories are listed if they can't be watched
+constexpr static std::chrono::milliseconds pollInterval(250);
+
+FileWatcher::FileWatcher() {
+#ifdef GLWR_INOTIFY
+	_fd = inotify_init1(IN_CLOEXEC);
+
+	if (_fd < 0) {
+		throw std::runtime_error(std::string("Cannot watch files: ") + std::strerror(errno));
+	}
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef GLWR_INOTIFY
+	if (_fd >= 0) {
+		close(_fd);
+	}
+#endif
+}
+
+void FileWatcher::Watch(const std::filesystem::path& dir) {
+	std::string key = std::filesystem::absolute(dir).lexically_normal().generic_string();
+
+	if (_dirs.contains(key)) {
+		return;
+	}
+
+#ifdef GLWR_INOTIFY
+	// a directory that doesn't exist is tried again the next time
+	int watch = inotify_add_watch(_fd, key.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+
+	if (watch >= 0) {
+		_watches[watch] = key;
+		_dirs[key];
+	}
+#else
+	_dirs[key] = List_(key);
+#endif
+}
+
+FileWatcher::Changes FileWatcher::Wait(std::chrono::milliseconds settle) {
+	Changes changes;
+
+	while (!Read_(changes, forever)) {}
+	while (Read_(changes, settle)) {}
+
+	std::sort(changes.files.begin(), changes.files.end());
+	changes.files.erase(std::unique(changes.files.begin(), changes.files.end()), changes.files.end());
+	return changes;
+}
+
+bool FileWatcher::Read_(Changes& changes, std::chrono::milliseconds timeout) {
+#ifdef GLWR_INOTIFY
+	pollfd events{ _fd, POLLIN, 0 };
+	int ready = poll(&events, 1, static_cast<int>(timeout.count()));
+
+	if (ready < 0 && errno != EINTR) {
+		throw std::runtime_error(std::string("Cannot watch files: ") + std::strerror(errno));
+	}
+
+	if (ready <= 0) {
+		return false;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size = read(_fd, buffer, sizeof(buffer));
+
+	for (ssize_t offset = 0; offset < size;) {
+		const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+		offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+		if (event->mask & IN_Q_OVERFLOW) {
+			changes.lost = true;
+		} else if (auto iter = _watches.find(event->wd); iter != _watches.end() && event->len > 0) {
+			changes.files.push_back(iter->second / event->name);
+		}
+	}
+
+	return size > 0;
+#else
+	// list the directories until something changed, or the timeout passed
+	auto waited = std::chrono::milliseconds::zero();
+
+	while (timeout == forever || waited < timeout) {
+		auto interval = timeout == forever ? pollInterval : std::min(pollInterval, timeout - waited);
+		std::this_thread::sleep_for(interval);
+		waited += interval;
+
+		bool changed = false;
+
+		for (auto& [dir, times] : _dirs) {
+			Times current = List_(dir);
+
+			for (const auto& [file, time] : current) {
+				if (auto iter = times.find(file); iter == times.end() || iter->second != time) {
+					changes.files.emplace_back(file);
+					changed = true;
+				}
+			}
+
+			for (const auto& [file, time] : times) {
+				if (!current.contains(file)) {
+					changes.files.emplace_back(file);
+					changed = true;
+				}
+			}
+
+			times = std::move(current);
+		}
+
+		if (changed) {
+			return true;
+		}
+	}
+
+	return false;
+#endif
+}
+
+FileWatcher::Times FileWatcher::List_(const std::filesystem::path& dir) {
+	Times times;
+	std::error_code error;
+
+	for (const auto& entry : std::filesystem::directory_iterator(dir, error)) {
+		if (entry.is_regular_file(error)) {
+			times[entry.path().generic_string()] = entry.last_write_time(error);
+		}
+	}
+
+	return times;
+}
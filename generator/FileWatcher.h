@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_FILEWATCHER_H
+#define GLWR_FILEWATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Waits for files in a set of directories to change. On Linux, the changes are
+ * reported by inotify. Elsewhere, the directories are listed a few times per
+ * second and the modification times of their files are compared.
+ */
+class FileWatcher {
+
+public:
+	struct Changes {
+		// the files that were written, created, removed or renamed
+		std::vector<std::filesystem::path> files;
+
+		// whether changes were lost, so that any file may have changed
+		bool lost = false;
+	};
+
+	/*
+	 * Throws a std::runtime_error if the system cannot watch files.
+	 */
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	/*
+	 * Starts watching the files directly in dir. Watching a directory twice
+	 * has no effect.
+	 */
+	void Watch(const std::filesystem::path& dir);
+
+	/*
+	 * Blocks until files change. Changes that follow within settle are
+	 * returned with them, so that saving a file is reported once.
+	 */
+	Changes Wait(std::chrono::milliseconds settle);
+
+private:
+	using Times = std::unordered_map<std::string, std::filesystem::file_time_type>;
+
+	bool Read_(Changes& changes, std::chrono::milliseconds timeout);
+	static Times List_(const std::filesystem::path& dir);
+
+	int _fd = -1;
+
+	// the watched directories, by their inotify watch, or with the
+	// modification times of their files when they are polled
+	std::unordered_map<int, std::filesystem::path> _watches;
+	std::unordered_map<std::string, Times> _dirs;
+
+};
+
+#endif
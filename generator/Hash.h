@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_HASH_H
+#define GLWR_HASH_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+constexpr std::uint64_t fnv1aOffset = 0xcbf29ce484222325ull;
+constexpr std::uint64_t fnv1aPrime = 0x100000001b3ull;
+
+/*
+ * 64-bit FNV-1a. Pass a previous result as hash to continue hashing.
+ */
+constexpr std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = fnv1aOffset) {
+	for (char c : data) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= fnv1aPrime;
+	}
+
+	return hash;
+}
+
+inline std::string hashToString(std::uint64_t hash) {
+	constexpr std::string_view digits = "0123456789abcdef";
+	std::string result(16, '0');
+
+	for (auto iter = result.rbegin(); iter != result.rend(); ++iter) {
+		*iter = digits[hash & 0xf];
+		hash >>= 4;
+	}
+
+	return result;
+}
+
+inline std::optional<std::uint64_t> hashFromString(std::string_view str) {
+	if (str.size() != 16) {
+		return std::nullopt;
+	}
+
+	std::uint64_t hash = 0;
+
+	for (char c : str) {
+		hash <<= 4;
+
+		if (c >= '0' && c <= '9') {
+			hash |= static_cast<std::uint64_t>(c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			hash |= static_cast<std::uint64_t>(c - 'a' + 10);
+		} else {
+			return std::nullopt;
+		}
+	}
+
+	return hash;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_HASHMEMO_H
+#define GLWR_HASHMEMO_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Hash.h"
+
+/*
+ * A memo of values that are computed from a source text, addressed by the
+ * hash of the source. Every value is computed once, however often it is asked
+ * for. The memo can be used from multiple threads.
+ */
+template<typename Value>
+class HashMemo {
+
+public:
+	/*
+	 * Returns the value for source. If it is not in the memo, compute is called
+	 * with the hash of source and the value to fill in. Returns nullptr if a
+	 * different source with the same hash is already in the memo, in which case
+	 * the caller computes the value itself.
+	 */
+	template<typename F>
+	const Value* Get(std::string_view source, const F& compute) {
+		std::uint64_t hash = fnv1a(source);
+		Entry* entry = nullptr;
+
+		{
+			std::shared_lock lock(_mutex);
+
+			if (auto iter = _entries.find(hash); iter != _entries.end()) {
+				entry = iter->second.get();
+			}
+		}
+
+		if (!entry) {
+			std::unique_lock lock(_mutex);
+
+			auto& slot = _entries[hash];
+			if (!slot) {
+				slot = std::make_unique<Entry>();
+				slot->source = source;
+			}
+
+			entry = slot.get();
+		}
+
+		if (entry->source != source) {
+			return nullptr;
+		}
+
+		bool miss = false;
+		std::call_once(entry->computed, [&]() {
+			compute(hash, entry->value);
+			miss = true;
+		});
+
+		if (miss) {
+			_misses++;
+		} else {
+			_hits++;
+		}
+
+		return &entry->value;
+	}
+
+	/*
+	 * Returns the value of the source with the given hash, or nullptr if there
+	 * is none.
+	 */
+	const Value* Find(std::uint64_t hash) const {
+		std::shared_lock lock(_mutex);
+
+		if (auto iter = _entries.find(hash); iter != _entries.end()) {
+			return &iter->second->value;
+		}
+
+		return nullptr;
+	}
+
+	/*
+	 * Drops every value whose hash keep returns false for. No pointer to a
+	 * dropped value may be in use.
+	 */
+	template<typename F>
+	void Retain(const F& keep) {
+		std::unique_lock lock(_mutex);
+
+		std::erase_if(_entries, [&](const auto& entry) {
+			return !keep(entry.first);
+		});
+	}
+
+	std::size_t Hits() const { return _hits; }
+	std::size_t Misses() const { return _misses; }
+
+private:
+	struct Entry {
+		std::string source;
+		std::once_flag computed;
+		Value value;
+	};
+
+	mutable std::shared_mutex _mutex;
+	std::unordered_map<std::uint64_t, std::unique_ptr<Entry>> _entries;
+
+	std::atomic<std::size_t> _hits = 0;
+	std::atomic<std::size_t> _misses = 0;
+
+};
+
+#endif
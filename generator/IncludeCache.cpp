@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "IncludeCache.h"
+
+#include <algorithm>
+
+const IncludeCache::Fragment& IncludeCache::Get(const std::filesystem::path& path, const Loader& load) {
+	std::string key = path.lexically_normal().string();
+	Entry* entry = nullptr;
+
+	{
+		std::shared_lock lock(_mutex);
+
+		if (auto iter = _entries.find(key); iter != _entries.end()) {
+			entry = iter->second.get();
+		}
+	}
+
+	if (!entry) {
+		std::unique_lock lock(_mutex);
+
+		auto& slot = _entries[key];
+		if (!slot) {
+			slot = std::make_unique<Entry>();
+		}
+
+		entry = slot.get();
+	}
+
+	bool miss = false;
+	std::call_once(entry->loaded, [&]() {
+		load(path, entry->fragment);
+		miss = true;
+	});
+
+	if (miss) {
+		_misses++;
+	} else {
+		_hits++;
+	}
+
+	return entry->fragment;
+}
+
+void IncludeCache::Forget(const std::filesystem::path& path) {
+	std::string key = path.lexically_normal().string();
+	std::unique_lock lock(_mutex);
+
+	// the includes of a fragment are all files it includes, however deeply,
+	// so one pass finds every fragment that has the file rendered into it
+	std::erase_if(_entries, [&](const auto& entry) {
+		const std::vector<std::string>& includes = entry.second->fragment.includes;
+		return entry.first == key || std::find(includes.begin(), includes.end(), key) != includes.end();
+	});
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_INCLUDECACHE_H
+#define GLWR_INCLUDECACHE_H
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileBuffer.h"
+#include "XmlHelper.h"
+
+/*
+ * A process-wide cache of xi:include fragments, keyed by their path relative to
+ * the gl4 refpages.
+ * Each fragment is loaded, parsed and rendered once per run, however many
+ * refpages include it. The cache can be used from multiple threads.
+ */
+class IncludeCache {
+
+public:
+	struct Fragment {
+		// the document is parsed in place, so it points into the buffer
+		FileBuffer buffer;
+		Document document;
+
+		// the rendered fragment
+		std::string text;
+
+		// the diagnostics of rendering the fragment, one per line, without the
+		// '@page' prefix
+		std::string diagnostics;
+
+		// the files included by the fragment itself
+		std::vector<std::string> includes;
+	};
+
+	using Loader = std::function<void(const std::filesystem::path&, Fragment&)>;
+
+	/*
+	 * Returns the fragment for path. If it is not in the cache, load is called
+	 * to fill it in. Concurrent requests for the same fragment wait for the
+	 * first one to finish loading.
+	 */
+	const Fragment& Get(const std::filesystem::path& path, const Loader& load);
+
+	/*
+	 * Drops the fragment for path, and every fragment that includes it, so
+	 * that they are loaded again the next time they are requested. No
+	 * reference to them may be in use.
+	 */
+	void Forget(const std::filesystem::path& path);
+
+	std::size_t Hits() const { return _hits; }
+	std::size_t Misses() const { return _misses; }
+
+private:
+	struct Entry {
+		std::once_flag loaded;
+		Fragment fragment;
+	};
+
+	std::shared_mutex _mutex;
+	std::unordered_map<std::string, std::unique_ptr<Entry>> _entries;
+
+	std::atomic<std::size_t> _hits = 0;
+	std::atomic<std::size_t> _misses = 0;
+
+};
+
+inline IncludeCache includeCache;
+
+#endif
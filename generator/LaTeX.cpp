@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "LaTeX.h"
+#include "PerfectHash.h"
+
+static bool isLetter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// the binary operators, written as commands and as characters
+constexpr static auto operatorCommands = makePerfectHashMap<std::string_view>({
+		{ "times", "&times;" },
+		{ "cdot", "&middot;" },
+		{ "pm", "&plusmn;" },
+		{ "leq", "&le;" },
+		{ "le", "&le;" },
+		{ "geq", "&ge;" },
+		{ "ge", "&ge;" },
+		{ "neq", "&ne;" },
+		{ "ne", "&ne;" },
+		{ "bmod", "mod" }
+});
+
+constexpr static auto operatorChars = makePerfectHashMap<std::string_view>({
+		{ "+", "+" },
+		{ "-", "-" },
+		{ "=", "=" },
+		{ "<", "&lt;" },
+		{ ">", "&gt;" }
+});
+
+constexpr static auto symbols = makePerfectHashMap<std::string_view>({
+		{ "alpha", "&alpha;" },
+		{ "beta", "&beta;" },
+		{ "gamma", "&gamma;" },
+		{ "delta", "&delta;" },
+		{ "epsilon", "&epsilon;" },
+		{ "theta", "&theta;" },
+		{ "lambda", "&lambda;" },
+		{ "mu", "&mu;" },
+		{ "pi", "&pi;" },
+		{ "sigma", "&sigma;" },
+		{ "phi", "&phi;" },
+		{ "omega", "&omega;" },
+		{ "infty", "&infin;" }
+});
+
+// the names of functions, which are not in italics
+constexpr static auto functions = makePerfectHashSet({
+		"log", "ln", "exp", "sin", "cos", "tan", "min", "max"
+});
+
+// the functions that the refpages write without a backslash
+constexpr static auto bareFunctions = makePerfectHashSet({
+		"log", "sizeof"
+});
+
+// the delimiters of \left and \right, and the brackets written as commands
+constexpr static auto delimiters = makePerfectHashMap<std::string_view>({
+		{ "lfloor", "&lfloor;" },
+		{ "rfloor", "&rfloor;" },
+		{ "lceil", "&lceil;" },
+		{ "rceil", "&rceil;" },
+		{ "{", "{" },
+		{ "}", "}" }
+});
+
+/*
+ * A recursive descent parser of TeX math, which renders as it parses. Spaces
+ * in the input are not significant, as in TeX: the spacing of the output only
+ * depends on the operators.
+ */
+class LaTeXParser {
+
+public:
+	explicit LaTeXParser(std::string_view input) :
+			_input(input) {}
+
+	bool Parse(std::string& output) {
+		bool atom;
+
+		if (!Fraction_(output, atom, true)) {
+			return false;
+		}
+
+		SkipSpaces_();
+		return _pos == _input.size();
+	}
+
+private:
+	// What an item of a sequence is, for the spacing around the next one.
+	enum class Item {
+		None,
+		Word,     // a variable or a number
+		Function,
+		Operand,  // anything else that has a value, or a closing bracket
+		Operator,
+		Open,
+		Comma
+	};
+
+	void SkipSpaces_() {
+		while (_pos < _input.size() && (_input[_pos] == ' ' || _input[_pos] == '\t' || _input[_pos] == '\n')) {
+			_pos++;
+		}
+	}
+
+	char Peek_() const {
+		return _pos < _input.size() ? _input[_pos] : '\0';
+	}
+
+	// Returns the name of the command at the current position without
+	// consuming it, or an empty string if there is none.
+	std::string_view PeekCommand_() const {
+		if (Peek_() != '\\' || _pos + 1 >= _input.size()) {
+			return {};
+		}
+
+		std::size_t end = _pos + 1;
+		while (end < _input.size() && isLetter(_input[end])) {
+			end++;
+		}
+
+		// a command of a single other character, like \_
+		if (end == _pos + 1) {
+			end++;
+		}
+
+		return _input.substr(_pos + 1, end - _pos - 1);
+	}
+
+	bool Command_(std::string_view name) {
+		if (PeekCommand_() != name) {
+			return false;
+		}
+
+		_pos += name.size() + 1;
+		return true;
+	}
+
+	// Parses a sequence, followed by \over and a second sequence if there is
+	// one. atom is set if the result is a single variable, number or symbol.
+	bool Fraction_(std::string& output, bool& atom, bool italic) {
+		std::size_t begin = output.size();
+
+		if (!Sequence_(output, atom, italic)) {
+			return false;
+		}
+
+		if (!Command_("over")) {
+			return true;
+		}
+
+		std::string numerator = output.substr(begin);
+		bool numeratorAtom = atom;
+		output.resize(begin);
+
+		std::string denominator;
+		bool denominatorAtom;
+
+		if (!Sequence_(denominator, denominatorAtom, italic)) {
+			return false;
+		}
+
+		// short fractions stay on the line
+		if (numeratorAtom && denominatorAtom) {
+			output.append(numerator).append("/").append(denominator);
+		} else {
+			output.append("<sup>").append(numerator).append("</sup>/<sub>").append(denominator).append("</sub>");
+		}
+
+		atom = false;
+		return true;
+	}
+
+	// Parses operands, operators and brackets up to a '}', \over, \right or
+	// the end of the input.
+	bool Sequence_(std::string& output, bool& atom, bool italic) {
+		atom = false;
+		Item previous = Item::None;
+		bool previousNumber = false;
+		std::size_t items = 0;
+
+		for (;; items++) {
+			SkipSpaces_();
+
+			std::string_view command = PeekCommand_();
+			char c = Peek_();
+
+			if (c == '\0' || c == '}' || command == "over" || command == "right") {
+				break;
+			}
+
+			if (previous == Item::Comma) {
+				// lists of numbers, like coordinates, are written without spaces
+				output.append(previousNumber && isDigit(c) ? "," : ", ");
+			}
+
+			// binary operators, or a sign
+			std::optional<std::string_view> op = command.empty() ? operatorChars.Find(_input.substr(_pos, 1)) : operatorCommands.Find(command);
+
+			if (op) {
+				_pos += command.empty() ? 1 : command.size() + 1;
+
+				if (previous == Item::None || previous == Item::Operator || previous == Item::Open || previous == Item::Comma) {
+					if (c != '+' && c != '-') {
+						return false;
+					}
+
+					output.append(*op);
+				} else {
+					output.append(" ").append(*op).append(" ");
+				}
+
+				previous = Item::Operator;
+				continue;
+			}
+
+			if (c == ',') {
+				_pos++;
+				previous = Item::Comma;
+				continue;
+			}
+
+			if (c == '(' || c == '[' || command == "lfloor" || command == "lceil") {
+				output.append(command.empty() ? _input.substr(_pos++, 1) : *delimiters.Find(command));
+				_pos += command.empty() ? 0 : command.size() + 1;
+				previous = Item::Open;
+				continue;
+			}
+
+			if (c == ')' || c == ']' || c == '.' || command == "rfloor" || command == "rceil") {
+				output.append(command.empty() ? _input.substr(_pos++, 1) : *delimiters.Find(command));
+				_pos += command.empty() ? 0 : command.size() + 1;
+				previous = Item::Operand;
+				continue;
+			}
+
+			// operands
+			std::string operand;
+			Item kind;
+			bool number = isDigit(c);
+
+			if (!Operand_(operand, kind, atom, italic)) {
+				return false;
+			}
+
+			// two words in a row are most likely text that is not math
+			if (previous == Item::Word && kind == Item::Word) {
+				return false;
+			}
+
+			if (previous == Item::Function) {
+				output.append(" ");
+			}
+
+			output.append(operand);
+			previous = kind;
+			previousNumber = number;
+		}
+
+		if (items == 0 || previous == Item::Operator || previous == Item::Open) {
+			return false;
+		}
+
+		if (previous == Item::Comma) {
+			output.append(",");
+		}
+
+		atom = atom && items == 1;
+		return true;
+	}
+
+	// Parses a variable, number, function name, symbol, group or \left and
+	// \right pair, with its subscripts and superscripts. atom is set if it is
+	// a single variable, number or symbol.
+	bool Operand_(std::string& output, Item& kind, bool& atom, bool italic) {
+		std::string_view command = PeekCommand_();
+		char c = Peek_();
+		bool italicName = false;
+
+		kind = Item::Operand;
+		atom = true;
+
+		if (isLetter(c) || command == "_") {
+			std::string name = Name_();
+
+			if (bareFunctions.Contains(name)) {
+				kind = Item::Function;
+				atom = false;
+				output.append(name);
+			} else {
+				kind = Item::Word;
+				italicName = italic;
+				output.append(italic ? "<i>" : "").append(name);
+			}
+		} else if (isDigit(c)) {
+			kind = Item::Word;
+			std::size_t begin = _pos;
+
+			while (isDigit(Peek_()) || (Peek_() == '.' && _pos + 1 < _input.size() && isDigit(_input[_pos + 1]))) {
+				_pos++;
+			}
+
+			output.append(_input.substr(begin, _pos - begin));
+		} else if (c == '{') {
+			if (!Group_(output, atom, italic)) {
+				return false;
+			}
+		} else if (Command_("left")) {
+			atom = false;
+
+			if (!Delimited_(output, italic)) {
+				return false;
+			}
+		} else if (functions.Contains(command)) {
+			_pos += command.size() + 1;
+			kind = Item::Function;
+			atom = false;
+			output.append(command);
+		} else if (auto symbol = symbols.Find(command)) {
+			_pos += command.size() + 1;
+			output.append(*symbol);
+		} else {
+			return false;
+		}
+
+		// the scripts of a variable are part of its name, which already is in
+		// italics
+		if (!Scripts_(output, italic && !italicName)) {
+			return false;
+		}
+
+		if (italicName) {
+			output.append("</i>");
+		}
+
+		return true;
+	}
+
+	// Parses the name of a variable, in which \_ is an underscore.
+	std::string Name_() {
+		std::string name;
+
+		for (;;) {
+			if (isLetter(Peek_()) || (!name.empty() && isDigit(Peek_()))) {
+				name += _input[_pos++];
+			} else if (Command_("_")) {
+				name += '_';
+			} else {
+				return name;
+			}
+		}
+	}
+
+	bool Group_(std::string& output, bool& atom, bool italic) {
+		_pos++;
+
+		if (!Fraction_(output, atom, italic)) {
+			return false;
+		}
+
+		SkipSpaces_();
+
+		if (Peek_() != '}') {
+			return false;
+		}
+
+		_pos++;
+		return true;
+	}
+
+	// Parses what follows \left: a delimiter, a fraction, \right and another
+	// delimiter.
+	bool Delimited_(std::string& output, bool italic) {
+		auto open = Delimiter_();
+		if (!open) {
+			return false;
+		}
+
+		std::string inner;
+		bool atom;
+
+		if (!Fraction_(inner, atom, italic) || !Command_("right")) {
+			return false;
+		}
+
+		auto close = Delimiter_();
+		if (!close) {
+			return false;
+		}
+
+		// symbols are set apart from what is between them, brackets are not
+		std::string_view openSpace = open->starts_with('&') ? " " : "";
+		std::string_view closeSpace = close->starts_with('&') ? " " : "";
+
+		output.append(*open).append(openSpace).append(inner).append(closeSpace).append(*close);
+		return true;
+	}
+
+	// Parses the delimiter after \left or \right. The delimiter '.' is empty.
+	std::optional<std::string_view> Delimiter_() {
+		SkipSpaces_();
+
+		if (std::string_view command = PeekCommand_(); !command.empty()) {
+			auto delimiter = delimiters.Find(command);
+
+			if (delimiter) {
+				_pos += command.size() + 1;
+			}
+
+			return delimiter;
+		}
+
+		switch (Peek_()) {
+			case '(':
+			case ')':
+			case '[':
+			case ']':
+			case '|':
+				_pos++;
+				return _input.substr(_pos - 1, 1);
+			case '.':
+				_pos++;
+				return std::string_view();
+			default:
+				return std::nullopt;
+		}
+	}
+
+	bool Scripts_(std::string& output, bool italic) {
+		for (;;) {
+			SkipSpaces_();
+
+			char c = Peek_();
+			if (c != '_' && c != '^') {
+				return true;
+			}
+
+			_pos++;
+			output.append(c == '_' ? "<sub>" : "<sup>");
+
+			if (!Script_(output, italic)) {
+				return false;
+			}
+
+			output.append(c == '_' ? "</sub>" : "</sup>");
+		}
+	}
+
+	// Parses the group or the single character after _ or ^.
+	bool Script_(std::string& output, bool italic) {
+		SkipSpaces_();
+		char c = Peek_();
+
+		if (c == '{') {
+			bool atom;
+			return Group_(output, atom, italic);
+		}
+
+		if (!isLetter(c) && !isDigit(c)) {
+			return false;
+		}
+
+		_pos++;
+
+		if (italic && isLetter(c)) {
+			output.append("<i>").append(1, c).append("</i>");
+		} else {
+			output.append(1, c);
+		}
+
+		return true;
+	}
+
+	std::string_view _input;
+	std::size_t _pos = 0;
+
+};
+
+std::optional<std::string> renderLaTeX(std::string_view input) {
+	std::string output;
+
+	if (!LaTeXParser(input).Parse(output)) {
+		return std::nullopt;
+	}
+
+	return output;
+}
+
+const std::optional<std::string>* LaTeXMemo::Get(std::string_view input) {
+	return _html.Get(input, [&](std::uint64_t, std::optional<std::string>& html) {
+		html = renderLaTeX(input);
+	});
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_LATEX_H
+#define GLWR_LATEX_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "HashMemo.h"
+
+/*
+ * Renders TeX math as HTML. Only the subset of TeX that the refpages use is
+ * supported: variables and numbers with subscripts and superscripts, groups,
+ * \over, binary operators like \times, \leq and \bmod, brackets and \left and
+ * \right delimiters like \lfloor. Returns an empty optional if input uses
+ * anything else.
+ */
+std::optional<std::string> renderLaTeX(std::string_view input);
+
+/*
+ * A process-wide memo of rendered TeX fragments, addressed by the hash of
+ * their source. Every fragment is rendered once per run. The memo can be used
+ * from multiple threads.
+ */
+class LaTeXMemo {
+
+public:
+	/*
+	 * Returns the rendering of input, rendering it if it is not in the memo
+	 * yet. Returns nullptr if a different source with the same hash is already
+	 * in the memo, in which case the caller renders it itself.
+	 */
+	const std::optional<std::string>* Get(std::string_view input);
+
+	/*
+	 * Drops every rendering. No pointer to one may be in use.
+	 */
+	void Clear() { _html.Retain([](std::uint64_t) { return false; }); }
+
+	std::size_t Hits() const { return _html.Hits(); }
+	std::size_t Misses() const { return _html.Misses(); }
+
+private:
+	HashMemo<std::optional<std::string>> _html;
+
+};
+
+inline LaTeXMemo latexMemo;
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "Manifest.h"
+#include "Hash.h"
+#include "OutputFile.h"
+
+#include <fstream>
+#include <sstream>
+
+constexpr static auto manifestHeader = "glwr-manifest 2";
+
+Manifest Manifest::Load(const std::filesystem::path& path) {
+	std::ifstream file(path);
+	std::string line;
+
+	if (!std::getline(file, line) || line != manifestHeader) {
+		return Manifest();
+	}
+
+	Manifest manifest;
+	Page* page = nullptr;
+
+	while (std::getline(file, line)) {
+		std::istringstream words(line);
+		std::string keyword;
+		words >> keyword;
+
+		if (keyword == "generator") {
+			words >> manifest.generator;
+		} else if (keyword == "options") {
+			words >> manifest.options;
+		} else if (keyword == "page") {
+			std::string name, input, output;
+			words >> name >> input;
+
+			auto inputHash = hashFromString(input);
+			if (!inputHash) {
+				return Manifest();
+			}
+
+			page = &manifest.pages[name];
+			page->input = *inputHash;
+
+			while (words >> output) {
+				auto outputHash = hashFromString(output);
+				if (!outputHash) {
+					return Manifest();
+				}
+
+				page->outputs.push_back(*outputHash);
+			}
+		} else if (keyword == "include" && page) {
+			std::string name, hash;
+			words >> name >> hash;
+
+			auto includeHash = hashFromString(hash);
+			if (!includeHash) {
+				return Manifest();
+			}
+
+			page->includes.emplace_back(std::move(name), *includeHash);
+		} else {
+			return Manifest();
+		}
+	}
+
+	return manifest;
+}
+
+void Manifest::Save(const std::filesystem::path& path) const {
+	std::stringstream ss;
+	ss << manifestHeader << '\n';
+	ss << "generator " << generator << '\n';
+	ss << "options " << options << '\n';
+
+	for (const auto& [name, page] : pages) {
+		ss << "page " << name << ' ' << hashToString(page.input);
+
+		for (std::uint64_t output : page.outputs) {
+			ss << ' ' << hashToString(output);
+		}
+
+		ss << '\n';
+
+		for (const auto& [include, hash] : page.includes) {
+			ss << "include " << include << ' ' << hashToString(hash) << '\n';
+		}
+	}
+
+	replaceFileIfChanged(path, ss.str());
+}
+
+bool Manifest::Compatible(const Manifest& previous) const {
+	return !generator.empty() && generator == previous.generator && options == previous.options;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_MANIFEST_H
+#define GLWR_MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * The record of a generator run: the hashes of the inputs of every page, the
+ * option profiles they were generated with and the hashes of the generated
+ * headers.
+ * A page whose inputs and header are unchanged since the previous run does not
+ * need to be generated again.
+ */
+class Manifest {
+
+public:
+	struct Page {
+		std::uint64_t input = 0;
+
+		// the hash of the generated header of every profile
+		std::vector<std::uint64_t> outputs;
+
+		// the included files (relative to the refpages directory) and their
+		// hashes
+		std::vector<std::pair<std::string, std::uint64_t>> includes;
+	};
+
+	/*
+	 * Loads a manifest. Returns an empty manifest if the file doesn't exist or
+	 * is not a valid manifest.
+	 */
+	static Manifest Load(const std::filesystem::path& path);
+
+	void Save(const std::filesystem::path& path) const;
+
+	/*
+	 * Whether the pages of a manifest can be reused by this one, i.e. both
+	 * were made by the same generator with the same options.
+	 */
+	bool Compatible(const Manifest& previous) const;
+
+	std::string generator;
+	std::string options;
+	std::map<std::string, Page> pages;
+
+};
+
+#endif
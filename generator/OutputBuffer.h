@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_OUTPUTBUFFER_H
+#define GLWR_OUTPUTBUFFER_H
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/*
+ * An std::ostream that renders into one contiguous, growing buffer, so that a
+ * whole file can be written at once. Unlike an std::stringstream, flushing it
+ * does nothing, and the contents can be read without copying them.
+ */
+class OutputBuffer : public std::ostream {
+
+public:
+	/*
+	 * Creates a buffer with room for capacity bytes before it has to grow.
+	 */
+	explicit OutputBuffer(std::size_t capacity = 0) :
+			std::ostream(&_buffer) {
+
+		_buffer.Reserve(capacity);
+	}
+
+	OutputBuffer(const OutputBuffer&) = delete;
+	OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+	std::string_view View() const {
+		return _buffer.View();
+	}
+
+	std::size_t Size() const {
+		return _buffer.View().size();
+	}
+
+	/*
+	 * Empties the buffer, keeping its memory.
+	 */
+	void Clear() {
+		_buffer.Clear();
+		clear();
+	}
+
+	/*
+	 * Moves the contents out of the buffer, without copying them. The buffer
+	 * is left empty, with as much room as the contents took.
+	 */
+	std::string Release() {
+		std::string contents = _buffer.Release();
+		clear();
+		return contents;
+	}
+
+private:
+	class Buffer : public std::streambuf {
+
+	public:
+		void Reserve(std::size_t capacity) {
+			if (capacity > _data.size()) {
+				Grow_(capacity);
+			}
+		}
+
+		std::string_view View() const {
+			return { pbase(), static_cast<std::size_t>(pptr() - pbase()) };
+		}
+
+		void Clear() {
+			setp(_data.data(), _data.data() + _data.size());
+		}
+
+		std::string Release() {
+			std::size_t size = View().size();
+			std::size_t capacity = _data.size();
+
+			_data.resize(size);
+			std::string contents = std::move(_data);
+
+			_data = std::string(capacity, '\0');
+			Clear();
+			return contents;
+		}
+
+	protected:
+		int_type overflow(int_type c) override {
+			if (traits_type::eq_int_type(c, traits_type::eof())) {
+				return traits_type::not_eof(c);
+			}
+
+			Grow_(_data.size() + 1);
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+			return c;
+		}
+
+		std::streamsize xsputn(const char* s, std::streamsize count) override {
+			auto size = static_cast<std::size_t>(count);
+
+			if (static_cast<std::size_t>(epptr() - pptr()) < size) {
+				Grow_(View().size() + size);
+			}
+
+			std::memcpy(pptr(), s, size);
+			pbump(static_cast<int>(size));
+			return count;
+		}
+
+		// only telling the position is supported, e.g. for tellp()
+		pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+			if (offset == 0 && dir == std::ios_base::cur && (which & std::ios_base::out)) {
+				return pos_type(static_cast<off_type>(pptr() - pbase()));
+			}
+
+			return pos_type(off_type(-1));
+		}
+
+	private:
+		void Grow_(std::size_t minimum) {
+			std::size_t size = View().size();
+
+			_data.resize(std::max(minimum, _data.size() * 2));
+			setp(_data.data(), _data.data() + _data.size());
+			pbump(static_cast<int>(size));
+		}
+
+		std::string _data;
+
+	};
+
+	Buffer _buffer;
+
+};
+
+#endif
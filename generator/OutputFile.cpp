@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "OutputFile.h"
+#include "FileBuffer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+bool replaceFileIfChanged(const std::filesystem::path& path, std::string_view contents) {
+	if (fileHasContents(path, contents)) {
+		return false;
+	}
+
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+	// the last of the contents is only written by closing the file, so a full
+	// disk may only show then
+	file.close();
+
+	if (file.fail()) {
+		std::error_code error;
+		std::filesystem::remove(temporary, error);
+		throw std::runtime_error("Could not write " + temporary.string());
+	}
+
+	std::filesystem::rename(temporary, path);
+	return true;
+}
+
+bool fileHasContents(const std::filesystem::path& path, std::string_view contents) {
+	FileBuffer existing = FileBuffer::Map(path);
+	bool exists = existing.Size() > 0 || std::filesystem::exists(path);
+
+	return exists && std::string_view(existing.Data(), existing.Size()) == contents;
+}
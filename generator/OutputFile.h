@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_OUTPUTFILE_H
+#define GLWR_OUTPUTFILE_H
+
+#include <filesystem>
+#include <string_view>
+
+/*
+ * Replaces the file at path with contents, unless it already has exactly those
+ * contents, in which case the file (and its modification time) is left alone.
+ * The file is written to a temporary file first and then renamed over the
+ * original, so readers never see a partially written file. Returns whether
+ * the file was written.
+ */
+bool replaceFileIfChanged(const std::filesystem::path& path, std::string_view contents);
+
+/*
+ * Returns whether the file at path exists and has exactly contents.
+ */
+bool fileHasContents(const std::filesystem::path& path, std::string_view contents);
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_PERFECTHASH_H
+#define GLWR_PERFECTHASH_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "Hash.h"
+
+/*
+ * A map from a fixed set of strings to values, built at compile time. Every key
+ * has a slot of its own, so a lookup hashes the key once and compares it with
+ * at most one key of the map.
+ * The keys are divided in small buckets by their hash. Each bucket has a seed
+ * that was chosen so that its keys land on empty slots (hash and displace).
+ */
+template<typename Value, std::size_t N>
+class PerfectHashMap {
+
+public:
+	using Entry = std::pair<std::string_view, Value>;
+
+	constexpr explicit PerfectHashMap(const std::array<Entry, N>& entries) :
+			_entries(entries) {
+
+		std::array<std::uint64_t, N> hashes {};
+		std::array<std::size_t, bucketCount> sizes {};
+
+		for (std::size_t i = 0; i < N; i++) {
+			hashes[i] = fnv1a(_entries[i].first);
+			sizes[Bucket_(hashes[i])]++;
+		}
+
+		// place the largest buckets first, while there are still many free
+		// slots
+		std::array<std::size_t, N> order {};
+
+		for (std::size_t i = 0; i < N; i++) {
+			order[i] = i;
+
+			for (std::size_t j = i; j > 0; j--) {
+				std::size_t a = Bucket_(hashes[order[j]]);
+				std::size_t b = Bucket_(hashes[order[j - 1]]);
+
+				if (sizes[a] < sizes[b] || (sizes[a] == sizes[b] && a >= b)) {
+					break;
+				}
+
+				std::swap(order[j], order[j - 1]);
+			}
+		}
+
+		for (std::size_t begin = 0; begin < N;) {
+			std::size_t bucket = Bucket_(hashes[order[begin]]);
+			std::size_t end = begin + sizes[bucket];
+
+			_seeds[bucket] = Place_(hashes, order, begin, end);
+			begin = end;
+		}
+	}
+
+	/*
+	 * Returns the value of key, or an empty optional if key is not in the map.
+	 */
+	constexpr std::optional<Value> Find(std::string_view key) const {
+		std::uint64_t hash = fnv1a(key);
+		std::uint16_t slot = _slots[Slot_(hash, _seeds[Bucket_(hash)])];
+
+		if (slot != 0 && _entries[slot - 1].first == key) {
+			return _entries[slot - 1].second;
+		}
+
+		return std::nullopt;
+	}
+
+	constexpr Value Find(std::string_view key, Value fallback) const {
+		return Find(key).value_or(fallback);
+	}
+
+	constexpr bool Contains(std::string_view key) const {
+		return Find(key).has_value();
+	}
+
+private:
+	static_assert(N > 0 && N < 0xffff, "a perfect hash map holds 1 to 65534 keys");
+
+	// about two keys per bucket, and a load factor of at most one half
+	static constexpr std::size_t bucketCount = N / 2 + 1;
+	static constexpr std::size_t slotCount = std::bit_ceil(2 * N);
+
+	static constexpr std::uint64_t Mix_(std::uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x;
+	}
+
+	static constexpr std::size_t Bucket_(std::uint64_t hash) {
+		return Mix_(hash) % bucketCount;
+	}
+
+	static constexpr std::size_t Slot_(std::uint64_t hash, std::uint32_t seed) {
+		return Mix_(hash + seed * 0x9e3779b97f4a7c15ull) & (slotCount - 1);
+	}
+
+	// Finds a seed that puts the keys order[begin, end) of a bucket on free
+	// slots, and takes those slots.
+	constexpr std::uint32_t Place_(const std::array<std::uint64_t, N>& hashes, const std::array<std::size_t, N>& order, std::size_t begin, std::size_t end) {
+		for (std::uint32_t seed = 0; seed < 0x100000; seed++) {
+			bool free = true;
+
+			for (std::size_t i = begin; i < end && free; i++) {
+				std::size_t slot = Slot_(hashes[order[i]], seed);
+				free = _slots[slot] == 0;
+
+				for (std::size_t j = begin; j < i && free; j++) {
+					free = Slot_(hashes[order[j]], seed) != slot;
+				}
+			}
+
+			if (free) {
+				for (std::size_t i = begin; i < end; i++) {
+					_slots[Slot_(hashes[order[i]], seed)] = static_cast<std::uint16_t>(order[i] + 1);
+				}
+
+				return seed;
+			}
+		}
+
+		throw std::logic_error("no perfect hash found; are there duplicate keys?");
+	}
+
+	std::array<Entry, N> _entries {};
+	std::array<std::uint32_t, bucketCount> _seeds {};
+
+	// the index of the entry in each slot, plus one, or zero if it is empty
+	std::array<std::uint16_t, slotCount> _slots {};
+
+};
+
+/*
+ * Builds a perfect hash map from a list of key-value pairs.
+ */
+template<typename Value, std::size_t N>
+constexpr PerfectHashMap<Value, N> makePerfectHashMap(const std::pair<std::string_view, Value> (&entries)[N]) {
+	std::array<std::pair<std::string_view, Value>, N> array {};
+
+	for (std::size_t i = 0; i < N; i++) {
+		array[i] = entries[i];
+	}
+
+	return PerfectHashMap<Value, N>(array);
+}
+
+/*
+ * A set of strings is a perfect hash map whose values are not used.
+ */
+template<std::size_t N>
+using PerfectHashSet = PerfectHashMap<bool, N>;
+
+template<std::size_t N>
+constexpr PerfectHashSet<N> makePerfectHashSet(const std::string_view (&keys)[N]) {
+	std::array<std::pair<std::string_view, bool>, N> array {};
+
+	for (std::size_t i = 0; i < N; i++) {
+		array[i] = { keys[i], true };
+	}
+
+	return PerfectHashSet<N>(array);
+}
+
+#endif
@@ -2,10 +2,22 @@
  * Copyright (c) 2022 Levi van Rheenen
  */
 #include "Refpage.h"
+#include "Binary.h"
+#include "DocPool.h"
+#include "FileBuffer.h"
+#include "Hash.h"
+#include "IncludeCache.h"
+#include "LaTeX.h"
+#include "OutputBuffer.h"
+#include "RefpageSource.h"
+#include "Stats.h"
+#include "TextTokens.h"
 #include "gl1.h"
 
+#include <algorithm>
 #include <cstring>
-#include <fstream>
+#include <sstream>
+#include <utility>
 
 #include <ctre.hpp>
 
@@ -20,212 +32,760 @@ static std::string& trimr(std::string& str) {
 	return str;
 }
 
-Refpage::Refpage(std::filesystem::path dir, std::istream& input, std::string name) :
-		_dir(std::move(dir)),
-		_name(std::move(name)) {
+static bool isTeXSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// Appends text with every line break, and the whitespace after it, replaced by
+// a single space.
+static void appendCollapsed(std::string& output, std::string_view text) {
+	std::size_t i = 0;
+
+	while (i < text.size()) {
+		std::size_t lineBreak = text.find('\n', i);
+		if (lineBreak == std::string_view::npos) {
+			break;
+		}
+
+		// a \r directly before the line break is part of it
+		std::size_t end = lineBreak > i && text[lineBreak - 1] == '\r' ? lineBreak - 1 : lineBreak;
+		output.append(text.substr(i, end - i));
+		output += ' ';
+
+		i = lineBreak + 1;
+		while (i < text.size() && isTeXSpace(text[i])) {
+			i++;
+		}
+	}
+
+	output.append(text.substr(i));
+}
+
+struct TeXMatch {
+	std::size_t begin;
+	std::size_t end;
+	std::string_view type;
+	std::string_view contents;
+};
+
+// Finds the first $...$ or $$...$$ expression in input.
+static std::optional<TeXMatch> findTeX(std::string_view input) {
+	std::size_t begin = input.find('$');
+
+	while (begin != std::string_view::npos) {
+		std::size_t dollars = begin + 1 < input.size() && input[begin + 1] == '$' ? 2 : 1;
+		std::size_t contentsBegin = begin + dollars;
+		std::size_t contentsEnd = std::min(input.find('$', contentsBegin), input.size());
+
+		if (contentsEnd > contentsBegin && input.substr(contentsEnd, dollars) == input.substr(begin, dollars)) {
+			return TeXMatch {
+					begin,
+					contentsEnd + dollars,
+					input.substr(begin, dollars),
+					input.substr(contentsBegin, contentsEnd - contentsBegin)
+			};
+		}
+
+		begin = input.find('$', begin + 1);
+	}
+
+	return std::nullopt;
+}
+
+// Binary (de)serialization of the refpage model. Every type is written as its
+// members in declaration order; containers are prefixed with their size. The
+// model is read into the arena of the page it is read for.
+
+class ModelReader : public BinaryReader {
+
+public:
+	ModelReader(std::string_view data, Refpage::Allocator allocator) :
+			BinaryReader(data),
+			allocator(allocator) {}
+
+	Refpage::Allocator allocator;
+
+};
+
+static void write(BinaryWriter& writer, std::string_view value) {
+	writer.WriteString(value);
+}
+
+template<typename A>
+static void read(ModelReader& reader, std::basic_string<char, std::char_traits<char>, A>& value) {
+	value = reader.ReadString();
+}
+
+template<typename T, typename A>
+static void write(BinaryWriter& writer, const std::vector<T, A>& values) {
+	writer.WriteNumber(values.size());
+
+	for (const auto& value : values) {
+		write(writer, value);
+	}
+}
+
+template<typename T, typename A>
+static void read(ModelReader& reader, std::vector<T, A>& values) {
+	auto size = reader.ReadNumber();
+	values.clear();
+
+	for (std::uint64_t i = 0; i < size && !reader.Failed(); i++) {
+		read(reader, values.emplace_back());
+	}
+}
+
+template<typename T>
+static void write(BinaryWriter& writer, const std::optional<T>& value) {
+	writer.WriteBool(value.has_value());
+
+	if (value) {
+		write(writer, *value);
+	}
+}
+
+template<typename T>
+static void read(ModelReader& reader, std::optional<T>& value) {
+	value.reset();
+
+	if (reader.ReadBool()) {
+		read(reader, value.emplace(reader.allocator));
+	}
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_copyright& value) {
+	write(writer, value.year);
+	write(writer, value.holder);
+}
+
+static void read(ModelReader& reader, Refpage::impl_copyright& value) {
+	read(reader, value.year);
+	read(reader, value.holder);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refmeta& value) {
+	write(writer, value.refentrytitle);
+	write(writer, value.manvolnum);
+}
+
+static void read(ModelReader& reader, Refpage::impl_refmeta& value) {
+	read(reader, value.refentrytitle);
+	read(reader, value.manvolnum);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refnamediv& value) {
+	write(writer, value.refdescriptor);
+	write(writer, value.refnames);
+	write(writer, value.refpurpose);
+}
+
+static void read(ModelReader& reader, Refpage::impl_refnamediv& value) {
+	read(reader, value.refdescriptor);
+	read(reader, value.refnames);
+	read(reader, value.refpurpose);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_paramdef& value) {
+	write(writer, value.type);
+	write(writer, value.parameter);
+}
+
+static void read(ModelReader& reader, Refpage::impl_paramdef& value) {
+	read(reader, value.type);
+	read(reader, value.parameter);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_funcprototype& value) {
+	write(writer, value.funcdef.type);
+	write(writer, value.funcdef.function);
+	write(writer, value.paramdefs);
+	writer.WriteBool(value.gl1);
+}
+
+static void read(ModelReader& reader, Refpage::impl_funcprototype& value) {
+	read(reader, value.funcdef.type);
+	read(reader, value.funcdef.function);
+	read(reader, value.paramdefs);
+	value.gl1 = reader.ReadBool();
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsynopsisdiv& value) {
+	write(writer, value.funcprototypes);
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsynopsisdiv& value) {
+	read(reader, value.funcprototypes);
+}
+
+static void write(BinaryWriter& writer, const TextToken& value) {
+	writer.WriteNumber(value.begin);
+	writer.WriteNumber(value.length);
+	writer.WriteNumber(static_cast<std::uint64_t>(value.kind));
+}
+
+static void read(ModelReader& reader, TextToken& value) {
+	value.begin = static_cast<std::uint32_t>(reader.ReadNumber());
+	value.length = static_cast<std::uint32_t>(reader.ReadNumber());
+
+	std::uint64_t kind = reader.ReadNumber();
+	if (kind > static_cast<std::uint64_t>(TokenKind::Unparsed)) {
+		reader.Fail();
+	}
+
+	value.kind = static_cast<TokenKind>(kind);
+}
+
+static void write(BinaryWriter& writer, std::uint32_t value) {
+	writer.WriteNumber(value);
+}
+
+static void read(ModelReader& reader, std::uint32_t& value) {
+	value = static_cast<std::uint32_t>(reader.ReadNumber());
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_abstract_text& value) {
+	write(writer, value.elements);
+	write(writer, value.tokens);
+	write(writer, value.tokenEnds);
+}
+
+static void read(ModelReader& reader, Refpage::impl_abstract_text& value) {
+	read(reader, value.elements);
+	read(reader, value.tokens);
+	read(reader, value.tokenEnds);
+
+	// Every element must end its tokens after the last one, and the tokens
+	// must lie in the text of their element, or wrapping the element reads
+	// past it.
+	if (value.tokenEnds.size() != value.elements.size()) {
+		reader.Fail();
+		return;
+	}
+
+	std::size_t begin = 0;
+
+	for (std::size_t i = 0; i < value.elements.size(); i++) {
+		std::size_t end = value.tokenEnds[i];
+
+		if (end < begin || end > value.tokens.size()) {
+			reader.Fail();
+			return;
+		}
+
+		for (const TextToken& token : std::span(value.tokens).subspan(begin, end - begin)) {
+			if (static_cast<std::uint64_t>(token.begin) + token.length > value.elements[i].size()) {
+				reader.Fail();
+				return;
+			}
+		}
 
-	// read the input
-	std::string fileContents(
-			(std::istreambuf_iterator<char>(input)),
-			std::istreambuf_iterator<char>());
-	char* buf = &fileContents[0];
+		begin = end;
+	}
+
+	if (begin != value.tokens.size()) {
+		reader.Fail();
+	}
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_varlistentry& value) {
+	write(writer, value.terms);
+	write(writer, value.listitem.contents);
+}
 
-	// create the XML document
+static void read(ModelReader& reader, Refpage::impl_varlistentry& value) {
+	read(reader, value.terms);
+	read(reader, value.listitem.contents);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsect_parameters& value) {
+	write(writer, value.impl_for_function);
+	write(writer, value.varlistentries);
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsect_parameters& value) {
+	read(reader, value.impl_for_function);
+	read(reader, value.varlistentries);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsect_description& value) {
+	write(writer, value.impl_for_function);
+	write(writer, value.contents);
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsect_description& value) {
+	read(reader, value.impl_for_function);
+	read(reader, value.contents);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsect_parameters_2& value) {
+	write(writer, static_cast<const Refpage::impl_refsect_parameters&>(value));
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsect_parameters_2& value) {
+	read(reader, static_cast<Refpage::impl_refsect_parameters&>(value));
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsect_description_2& value) {
+	write(writer, static_cast<const Refpage::impl_refsect_description&>(value));
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsect_description_2& value) {
+	read(reader, static_cast<Refpage::impl_refsect_description&>(value));
+}
+
+// the sections that only hold text
+template<typename T>
+static auto write(BinaryWriter& writer, const T& value) -> decltype(value.contents, void()) {
+	write(writer, value.contents);
+}
+
+template<typename T>
+static auto read(ModelReader& reader, T& value) -> decltype(value.contents, void()) {
+	read(reader, value.contents);
+}
+
+static void write(BinaryWriter& writer, const Refpage::impl_refsect_versions& value) {
+	writer.WriteNumber(value.versions.size());
+
+	for (const auto& [function, version] : value.versions) {
+		writer.WriteString(function);
+		writer.WriteString(version);
+	}
+}
+
+static void read(ModelReader& reader, Refpage::impl_refsect_versions& value) {
+	auto size = reader.ReadNumber();
+	value.versions.clear();
+
+	for (std::uint64_t i = 0; i < size && !reader.Failed(); i++) {
+		std::string_view function = reader.ReadString();
+		value.Set(function, reader.ReadString());
+	}
+}
+
+// Returns the xml:id of the refsect1 start tag, or an empty string if it has
+// none.
+static std::string_view refsect1Id(std::string_view tag) {
+	std::size_t pos = tag.find("xml:id");
+	if (pos == std::string_view::npos) {
+		return {};
+	}
+
+	pos = tag.find_first_of("\"'", pos + 6);
+	if (pos == std::string_view::npos) {
+		return {};
+	}
+
+	std::size_t end = tag.find(tag[pos], pos + 1);
+	if (end == std::string_view::npos) {
+		return {};
+	}
+
+	return tag.substr(pos + 1, end - pos - 1);
+}
+
+// Returns the position of the next tag at or after pos, or npos if there is
+// none. Tags in comments and character data are not tags, so they are skipped.
+static std::size_t nextTag(std::string_view text, std::size_t pos) {
+	while ((pos = text.find('<', pos)) != std::string_view::npos) {
+		std::string_view tag = text.substr(pos);
+
+		if (tag.starts_with("<!--")) {
+			pos = text.find("-->", pos + 4);
+		} else if (tag.starts_with("<![CDATA[")) {
+			pos = text.find("]]>", pos + 9);
+		} else {
+			return pos;
+		}
+	}
+
+	return std::string_view::npos;
+}
+
+// Removes the refsect1 sections that are disabled in the global include
+// options from the input, before it is loaded as a document. The input is
+// scanned as a stream of tags, and the sections are skipped as bytes, so none
+// of their nodes are ever built. Returns the new size of the input.
+static std::size_t removeDisabledSections(std::span<char> input) {
+	static constexpr auto sections = makePerfectHashMap<bool includes::*>({
+			{ "parameters", &includes::parameters },
+			{ "parameters2", &includes::parameters },
+			{ "description", &includes::description },
+			{ "description2", &includes::description },
+			{ "examples", &includes::examples },
+			{ "notes", &includes::notes },
+			{ "errors", &includes::errors },
+			{ "associatedgets", &includes::associated_gets },
+			{ "versions", &includes::version },
+			{ "seealso", &includes::see_also },
+			{ "Copyright", &includes::copyright }
+	});
+
+	std::string_view text(input.data(), input.size());
+	std::size_t read = 0;
+	std::size_t write = 0;
+	std::size_t pos = 0;
+
+	// copies the input up to end to where the output is
+	auto keep = [&](std::size_t end) {
+		if (write != read) {
+			std::memmove(input.data() + write, input.data() + read, end - read);
+		}
+
+		write += end - read;
+		read = end;
+	};
+
+	while ((pos = nextTag(text, pos)) != std::string_view::npos) {
+		std::string_view tag = text.substr(pos);
+
+		if (!tag.starts_with("<refsect1") || tag.size() < 10 || std::string_view(" \t\r\n>").find(tag[9]) == std::string_view::npos) {
+			pos++;
+			continue;
+		}
+
+		std::size_t tagEnd = tag.find('>');
+		std::size_t end = nextTag(text, pos + 1);
+
+		while (end != std::string_view::npos && !text.substr(end).starts_with("</refsect1>")) {
+			end = nextTag(text, end + 1);
+		}
+
+		if (tagEnd == std::string_view::npos || end == std::string_view::npos) {
+			break;
+		}
+
+		auto enabled = sections.Find(refsect1Id(tag.substr(0, tagEnd)));
+		end += 11;
+
+		// unknown sections are kept, to report them
+		if (enabled && !(include.**enabled)) {
+			keep(pos);
+			read = end;
+		}
+
+		pos = end;
+	}
+
+	keep(input.size());
+	return write;
+}
+
+Refpage::Refpage(const RefpageSource& refpages, std::span<char> input, std::string name, std::ostream& log) :
+		Refpage(refpages, std::move(name), log, input.size()) {
+
+	// create the XML document, parsing the input in place
 	pugi::xml_document doc;
-	doc.load_string(buf);
+
+	{
+		PhaseTimer timer(Phase::XmlLoad);
+		std::size_t size = removeDisabledSections(input);
+		doc.load_buffer_inplace(input.data(), size, xmlParseOptions, pugi::encoding_utf8);
+	}
 
 	// parse
+	PhaseTimer timer(Phase::Parse);
 	Parse_(doc);
 }
 
-void Refpage::GenerateHeader(std::ostream& output) const {
+Refpage::Refpage(const RefpageSource& refpages, std::string name, std::ostream& log, std::size_t arenaSize) :
+		_refpages(&refpages),
+		_name(std::move(name)),
+		_log(&log),
+		_arena(std::make_unique<std::pmr::monotonic_buffer_resource>(std::max<std::size_t>(arenaSize, 1024))),
+		_copyrights(Allocator_()),
+		_refmeta(Allocator_()),
+		_refnamediv(Allocator_()),
+		_refsynopsisdiv(Allocator_()) {}
+
+std::string Refpage::Serialize() const {
+	BinaryWriter writer;
+	write(writer, _includes);
+	write(writer, _copyrights);
+	write(writer, _refmeta);
+	write(writer, _refnamediv);
+	write(writer, _refsynopsisdiv);
+	write(writer, _refsect_parameters);
+	write(writer, _refsect_parameters_2);
+	write(writer, _refsect_description);
+	write(writer, _refsect_description_2);
+	write(writer, _refsect_examples);
+	write(writer, _refsect_notes);
+	write(writer, _refsect_errors);
+	write(writer, _refsect_associatedgets);
+	write(writer, _refsect_versions);
+	write(writer, _refsect_seealso);
+	write(writer, _refsect_copyright);
+	return writer.Data();
+}
+
+std::optional<Refpage> Refpage::Deserialize(const RefpageSource& refpages, std::string name, std::string_view data, std::ostream& log) {
+	// the model takes about twice the size of its serialized form
+	Refpage refpage(refpages, std::move(name), log, 2 * data.size());
+
+	ModelReader reader(data, refpage.Allocator_());
+	read(reader, refpage._includes);
+	read(reader, refpage._copyrights);
+	read(reader, refpage._refmeta);
+	read(reader, refpage._refnamediv);
+	read(reader, refpage._refsynopsisdiv);
+	read(reader, refpage._refsect_parameters);
+	read(reader, refpage._refsect_parameters_2);
+	read(reader, refpage._refsect_description);
+	read(reader, refpage._refsect_description_2);
+	read(reader, refpage._refsect_examples);
+	read(reader, refpage._refsect_notes);
+	read(reader, refpage._refsect_errors);
+	read(reader, refpage._refsect_associatedgets);
+	read(reader, refpage._refsect_versions);
+	read(reader, refpage._refsect_seealso);
+	read(reader, refpage._refsect_copyright);
+
+	if (reader.Failed() || !reader.AtEnd()) {
+		return std::nullopt;
+	}
+
+	return refpage;
+}
+
+const Refpage::String* Refpage::impl_refsect_versions::Find(std::string_view function) const {
+	auto iter = std::lower_bound(versions.begin(), versions.end(), function, [](const auto& entry, std::string_view function) {
+		return entry.first < function;
+	});
+
+	if (iter != versions.end() && iter->first == function) {
+		return &iter->second;
+	}
+
+	return nullptr;
+}
+
+void Refpage::impl_refsect_versions::Set(std::string_view function, std::string_view version) {
+	auto iter = std::lower_bound(versions.begin(), versions.end(), function, [](const auto& entry, std::string_view function) {
+		return entry.first < function;
+	});
+
+	if (iter != versions.end() && iter->first == function) {
+		iter->second = version;
+	} else {
+		versions.emplace(iter, function, version);
+	}
+}
+
+void Refpage::GenerateHeader(std::ostream& output, const includes& options, bool sharedDocs) const {
+	PhaseTimer timer(Phase::Generate);
 	output << glwrFunctionHeaderHead;
 
 	// #undef any non-gl1 prototype
 	bool first = true;
 	for (const auto& prototype : _refsynopsisdiv.funcprototypes) {
-		if (gl1.find(prototype.funcdef.function) == gl1.end()) {
+		if (!prototype.gl1) {
 			if (first) {
-				output << std::endl;
+				output << '\n';
 			}
 
-			output << "#undef " << prototype.funcdef.function << std::endl;
+			output << "#undef " << prototype.funcdef.function << '\n';
 			first = false;
 		}
 	}
 
-	// declare all function prototypes
+	// declare all function prototypes, rendering the comment sections they
+	// share only once
+	RenderedComments rendered;
+	rendered.sharedDocs = sharedDocs;
+
 	for (const auto& prototype : _refsynopsisdiv.funcprototypes) {
-		GenerateHeader_(output, prototype);
+		GenerateHeader_(output, prototype, options, rendered);
 	}
 }
 
-void Refpage::Set_(const char* name, std::string& str, std::string_view value) {
+std::ostream& Refpage::Log_() const {
+	if (_capture) {
+		return *_capture;
+	}
+
+	return *_log << "@" << _name;
+}
+
+void Refpage::Set_(const char* name, String& str, std::string_view value) {
 	if (str.empty()) {
 		str = value;
 		return;
 	}
 
-	std::cout << "@" << _name << " Duplicate value: " << name << std::endl;
+	Log_() << " Duplicate value: " << name << std::endl;
 }
 
-Node Refpage::GetOnlyChild_(Node node, const std::string_view& name, std::string_view child) {
+Node Refpage::GetOnlyChild_(Node node, const std::string_view& name, XmlName child) {
 	Node childNode = node.first_child();
 
 	if (childNode.next_sibling()) {
-		std::cout << "@" << _name << " node with multiple child nodes: " << name << std::endl;
-	} else if (std::string(childNode.name()) == child) {
+		Log_() << " node with multiple child nodes: " << name << std::endl;
+	} else if (xmlName(childNode.name()) == child) {
 		return childNode;
 	} else {
-		std::cout << "@" << _name << " node with invalid child node: " << name << std::endl;
+		Log_() << " node with invalid child node: " << name << std::endl;
 	}
 
 	return Node();
 }
 
 void Refpage::Parse_(const Document& doc) {
-	auto refentry = firstChild(doc, "refentry");
+	auto refentry = firstChild(doc, XmlName::Refentry);
 	ParseRefentry_(refentry);
 }
 
 void Refpage::ParseRefentry_(Node refentry) {
-	for (const auto& [node, name] : NodeNameIterator(refentry)) {
-		ParseNode_(node);
+	for (const auto& [node, name, token] : NodeNameIterator(refentry)) {
+		ParseNode_(node, name, token);
 	}
 }
 
-void Refpage::ParseNode_(Node node) {
-	std::string name = node.name();
-
-	if (name == "info") {
-		ParseInfo_(node);
-	} else if (name == "refmeta") {
-		ParseRefmeta_(node);
-	} else if (name == "refnamediv") {
-		ParseRefnamediv_(node);
-	} else if (name == "refsynopsisdiv") {
-		ParseRefsynopsisdiv_(node);
-	} else if (name == "refsect1") {
-		ParseRefsect1_(node);
-	} else {
-		std::cout << "@" << _name << " Unknown node: " << name << std::endl;
+void Refpage::ParseNode_(Node node, std::string_view name, XmlName token) {
+	switch (token) {
+		case XmlName::Info:
+			ParseInfo_(node);
+			break;
+		case XmlName::Refmeta:
+			ParseRefmeta_(node);
+			break;
+		case XmlName::Refnamediv:
+			ParseRefnamediv_(node);
+			break;
+		case XmlName::Refsynopsisdiv:
+			ParseRefsynopsisdiv_(node);
+			break;
+		case XmlName::Refsect1:
+			ParseRefsect1_(node);
+			break;
+		default:
+			Log_() << " Unknown node: " << name << std::endl;
+			break;
 	}
 }
 
 void Refpage::ParseInfo_(Node info) {
-	for (const auto& [node, name] : NodeNameIterator(info)) {
-		if (name == "copyright") {
+	for (const auto& [node, name, token] : NodeNameIterator(info)) {
+		if (token == XmlName::Copyright) {
 			impl_copyright& value = _copyrights.emplace_back();
 			ParseCopyright_(node, value);
 		} else {
-			std::cout << "@" << _name << " Unknown node: info." << name << std::endl;
+			Log_() << " Unknown node: info." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseRefmeta_(Node refmeta) {
-	for (const auto& [node, name] : NodeNameIterator(refmeta)) {
-		if (name == "refentrytitle") {
-			Set_("refmeta.refentrytitle", _refmeta.refentrytitle, node.text().as_string());
-		} else if (name == "manvolnum") {
-			Set_("refmeta.manvolnum", _refmeta.manvolnum, node.text().as_string());
-		} else {
-			std::cout << "@" << _name << " Unknown node: refmeta." << name << std::endl;
+	for (const auto& [node, name, token] : NodeNameIterator(refmeta)) {
+		switch (token) {
+			case XmlName::Refentrytitle:
+				Set_("refmeta.refentrytitle", _refmeta.refentrytitle, node.text().as_string());
+				break;
+			case XmlName::Manvolnum:
+				Set_("refmeta.manvolnum", _refmeta.manvolnum, node.text().as_string());
+				break;
+			default:
+				Log_() << " Unknown node: refmeta." << name << std::endl;
+				break;
 		}
 	}
 }
 
 void Refpage::ParseRefnamediv_(Node refnamediv) {
-	for (const auto& [node, name] : NodeNameIterator(refnamediv)) {
-		if (name == "refdescriptor") {
-			auto& refdescriptor = _refnamediv.refdescriptor.emplace();
-			Set_("refnamediv.refdescriptor", refdescriptor, node.text().as_string());
-		} else if (name == "refname") {
-			_refnamediv.refnames.emplace_back(node.text().as_string());
-		} else if (name == "refpurpose") {
-			std::string purpose = ParseText_(node);
-			Set_("refnamediv.refpurpose", _refnamediv.refpurpose, purpose);
-		} else {
-			std::cout << "@" << _name << " Unknown node: refnamediv." << name << std::endl;
+	for (const auto& [node, name, token] : NodeNameIterator(refnamediv)) {
+		switch (token) {
+			case XmlName::Refdescriptor: {
+				auto& refdescriptor = _refnamediv.refdescriptor.emplace(Allocator_());
+				Set_("refnamediv.refdescriptor", refdescriptor, node.text().as_string());
+				break;
+			}
+			case XmlName::Refname:
+				_refnamediv.refnames.emplace_back(node.text().as_string());
+				break;
+			case XmlName::Refpurpose: {
+				std::string purpose;
+				ParseText_(node, purpose);
+				Set_("refnamediv.refpurpose", _refnamediv.refpurpose, purpose);
+				break;
+			}
+			default:
+				Log_() << " Unknown node: refnamediv." << name << std::endl;
+				break;
 		}
 	}
 }
 
 void Refpage::ParseRefsynopsisdiv_(Node refsynopsisdiv) {
-	for (const auto& [node, name] : NodeNameIterator(refsynopsisdiv)) {
-		if (name == "title") {
+	for (const auto& [node, name, token] : NodeNameIterator(refsynopsisdiv)) {
+		if (token == XmlName::Title) {
 			continue; /* ignored */
-		} else if (name == "funcsynopsis") {
+		} else if (token == XmlName::Funcsynopsis) {
 			ParseFuncsynopsis_(node, _refsynopsisdiv);
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsynopsisdiv." << name << std::endl;
+			Log_() << " Unknown node: refsynopsisdiv." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseRefsect1_(Node refsect1) {
-	auto attr = firstAttribute(refsect1, "xml:id");
+	using Parser = void (Refpage::*)(Node);
+
+	static constexpr auto parsers = makePerfectHashMap<Parser>({
+			{ "parameters", &Refpage::ParseRefsect1Parameters_ },
+			{ "parameters2", &Refpage::ParseRefsect1Parameters2_ },
+			{ "description", &Refpage::ParseRefsect1Description_ },
+			{ "description2", &Refpage::ParseRefsect1Description2_ },
+			{ "examples", &Refpage::ParseRefsect1Examples_ },
+			{ "notes", &Refpage::ParseRefsect1Notes_ },
+			{ "errors", &Refpage::ParseRefsect1Errors_ },
+			{ "associatedgets", &Refpage::ParseRefsect1Associatedgets_ },
+			{ "versions", &Refpage::ParseRefsect1Versions_ },
+			{ "seealso", &Refpage::ParseRefsect1Seealso_ },
+			{ "Copyright", &Refpage::ParseRefsect1Copyright_ }
+	});
+
+	auto attr = firstAttribute(refsect1, XmlName::XmlId);
 	if (attr) {
-		std::string id = attr.value();
-
-		if (id == "parameters") {
-			ParseRefsect1Parameters_(refsect1);
-		} else if (id == "parameters2") {
-			ParseRefsect1Parameters2_(refsect1);
-		} else if (id == "description") {
-			ParseRefsect1Description_(refsect1);
-		} else if (id == "description2") {
-			ParseRefsect1Description2_(refsect1);
-		} else if (id == "examples") {
-			ParseRefsect1Examples_(refsect1);
-		} else if (id == "notes") {
-			ParseRefsect1Notes_(refsect1);
-		} else if (id == "errors") {
-			ParseRefsect1Errors_(refsect1);
-		} else if (id == "associatedgets") {
-			ParseRefsect1Associatedgets_(refsect1);
-		} else if (id == "versions") {
-			ParseRefsect1Versions_(refsect1);
-		} else if (id == "seealso") {
-			ParseRefsect1Seealso_(refsect1);
-		} else if (id == "Copyright") {
-			ParseRefsect1Copyright_(refsect1);
+		std::string_view id = attr.value();
+
+		if (auto parser = parsers.Find(id)) {
+			(this->**parser)(refsect1);
 		} else {
-			std::cout << "@" << _name << " Unknown refsect1 xml:id: " << id << std::endl;
+			Log_() << " Unknown refsect1 xml:id: " << id << std::endl;
 		}
 	} else {
-		std::cout << "@" << _name << " No attribute xml:id in refsect1" << std::endl;
+		Log_() << " No attribute xml:id in refsect1" << std::endl;
 	}
 }
 
 void Refpage::ParseCopyright_(Node copyright, impl_copyright& value) {
-	for (const auto& [node, name] : NodeNameIterator(copyright)) {
-		if (name == "year") {
+	for (const auto& [node, name, token] : NodeNameIterator(copyright)) {
+		if (token == XmlName::Year) {
 			Set_("info.copyright.year", value.year, node.text().as_string());
-		} else if (name == "holder") {
+		} else if (token == XmlName::Holder) {
 			Set_("info.copyright.holder", value.holder, node.text().as_string());
 		} else {
-			std::cout << "@" << _name << " Unknown node: info.copyright." << name << std::endl;
+			Log_() << " Unknown node: info.copyright." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseFuncsynopsis_(Node funcsynopsis, impl_refsynopsisdiv& value) {
-	for (const auto& [node, name] : NodeNameIterator(funcsynopsis)) {
-		if (name == "funcprototype") {
+	for (const auto& [node, name, token] : NodeNameIterator(funcsynopsis)) {
+		if (token == XmlName::Funcprototype) {
 			auto& value2 = value.funcprototypes.emplace_back();
 			ParseFuncprototype_(node, value2);
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsynopsisdiv.funcsynopsis." << name << std::endl;
+			Log_() << " Unknown node: refsynopsisdiv.funcsynopsis." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseFuncprototype_(Node funcprototype, impl_funcprototype& value) {
-	for (const auto& [node, name] : NodeNameIterator(funcprototype)) {
-		if (name == "funcdef") {
+	for (const auto& [node, name, token] : NodeNameIterator(funcprototype)) {
+		if (token == XmlName::Funcdef) {
 			ParseFuncdef_(node, value.funcdef);
-		} else if (name == "paramdef") {
+		} else if (token == XmlName::Paramdef) {
 			auto& value2 = value.paramdefs.emplace_back();
 
 			if (!ParseParamdef_(node, value2)) {
@@ -233,33 +793,35 @@ void Refpage::ParseFuncprototype_(Node funcprototype, impl_funcprototype& value)
 				value.paramdefs.pop_back();
 			}
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype." << name << std::endl;
+			Log_() << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype." << name << std::endl;
 		}
 	}
+
+	value.gl1 = gl1.Contains(value.funcdef.function);
 }
 
 void Refpage::ParseFuncdef_(Node funcdef, impl_funcdef& value) {
-	for (const auto& [node, name] : NodeNameIterator(funcdef)) {
-		if (name == "") {
+	for (const auto& [node, name, token] : NodeNameIterator(funcdef)) {
+		if (token == XmlName::Text) {
 			std::string type = node.text().as_string();
 			Set_("refsynopsisdiv.funcsynopsis.funcprototype.funcdef(value)", value.type, trimr(type));
-		} else if (name == "function") {
+		} else if (token == XmlName::Function) {
 			Set_("refsynopsisdiv.funcsynopsis.funcprototype.funcdef.function", value.function, node.text().as_string());
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype.function." << name << std::endl;
+			Log_() << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype.function." << name << std::endl;
 		}
 	}
 }
 
 bool Refpage::ParseParamdef_(Node paramdef, impl_paramdef& value) {
-	for (const auto& [node, name] : NodeNameIterator(paramdef)) {
-		if (name == "") {
+	for (const auto& [node, name, token] : NodeNameIterator(paramdef)) {
+		if (token == XmlName::Text) {
 			std::string type = node.text().as_string();
 			Set_("refsynopsisdiv.funcsynopsis.funcprototype.paramdef(value)", value.type, trimr(type));
-		} else if (name == "parameter") {
+		} else if (token == XmlName::Parameter) {
 			Set_("refsynopsisdiv.funcsynopsis.funcprototype.funcdef.parameter", value.parameter, node.text().as_string());
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype.paramdef." << name << std::endl;
+			Log_() << " Unknown node: refsynopsisdiv.funcsynopsis.funcprototype.paramdef." << name << std::endl;
 		}
 	}
 
@@ -267,106 +829,124 @@ bool Refpage::ParseParamdef_(Node paramdef, impl_paramdef& value) {
 }
 
 void Refpage::ParseRefsect1Parameters_(Node refsect1) {
+	PhaseTimer timer(Phase::Parameters);
+
 	if (include.parameters) {
-		auto& parameters = _refsect_parameters.emplace();
+		auto& parameters = _refsect_parameters.emplace(Allocator_());
 		ParseParameters_(refsect1, parameters);
 	}
 }
 
 void Refpage::ParseRefsect1Parameters2_(Node refsect1) {
+	PhaseTimer timer(Phase::Parameters);
+
 	if (include.parameters) {
-		auto& parameters2 = _refsect_parameters_2.emplace();
+		auto& parameters2 = _refsect_parameters_2.emplace(Allocator_());
 		ParseParameters_(refsect1, parameters2);
 	}
 }
 
 void Refpage::ParseRefsect1Description_(Node refsect1) {
+	PhaseTimer timer(Phase::Description);
+
 	if (include.description) {
-		auto& description = _refsect_description.emplace();
+		auto& description = _refsect_description.emplace(Allocator_());
 		ParseDescription_(refsect1, description);
 	}
 }
 
 void Refpage::ParseRefsect1Description2_(Node refsect1) {
+	PhaseTimer timer(Phase::Description);
+
 	if (include.description) {
-		auto& description2 = _refsect_description_2.emplace();
+		auto& description2 = _refsect_description_2.emplace(Allocator_());
 		ParseDescription_(refsect1, description2);
 	}
 }
 
 void Refpage::ParseRefsect1Examples_(Node refsect1) {
+	PhaseTimer timer(Phase::Examples);
+
 	if (include.examples) {
-		auto& examples = _refsect_examples.emplace();
+		auto& examples = _refsect_examples.emplace(Allocator_());
 		ParseAbstractText_(refsect1, examples.contents);
 	}
 }
 
 void Refpage::ParseRefsect1Notes_(Node refsect1) {
+	PhaseTimer timer(Phase::Notes);
+
 	if (include.notes) {
-		auto& notes = _refsect_notes.emplace();
+		auto& notes = _refsect_notes.emplace(Allocator_());
 		ParseAbstractText_(refsect1, notes.contents);
 	}
 }
 
 void Refpage::ParseRefsect1Errors_(Node refsect1) {
+	PhaseTimer timer(Phase::Errors);
+
 	if (include.errors) {
-		auto& errors = _refsect_errors.emplace();
+		auto& errors = _refsect_errors.emplace(Allocator_());
 		ParseAbstractText_(refsect1, errors.contents);
 	}
 }
 
 void Refpage::ParseRefsect1Associatedgets_(Node refsect1) {
+	PhaseTimer timer(Phase::AssociatedGets);
+
 	if (include.associated_gets) {
-		auto& associatedgets = _refsect_associatedgets.emplace();
+		auto& associatedgets = _refsect_associatedgets.emplace(Allocator_());
 		ParseAbstractText_(refsect1, associatedgets.contents);
 	}
 }
 
 void Refpage::ParseRefsect1Versions_(Node refsect1) {
+	PhaseTimer timer(Phase::Versions);
+
 	if (include.version) {
-		auto& versions = _refsect_versions.emplace();
+		auto& versions = _refsect_versions.emplace(Allocator_());
 		constexpr ctll::fixed_string regexVersion = R"(.*@role='(\d)(\d)'.*)";
 
-		Node informaltable = firstChild(refsect1, "informaltable");
+		Node informaltable = firstChild(refsect1, XmlName::Informaltable);
 		if (!informaltable) {
-			std::cout << "@" << _name << " refsect1(versions).informaltable missing" << std::endl;
+			Log_() << " refsect1(versions).informaltable missing" << std::endl;
 			return;
 		}
 
-		if (Node tgroup = GetOnlyChild_(informaltable, "informaltable", "tgroup"); tgroup) {
-			Node tbody = firstChild(tgroup, "tbody");
+		if (Node tgroup = GetOnlyChild_(informaltable, "informaltable", XmlName::Tgroup); tgroup) {
+			Node tbody = firstChild(tgroup, XmlName::Tbody);
 			if (!tbody) {
-				std::cout << "@" << _name << " refsect1(versions).informaltable.tbody missing" << std::endl;
+				Log_() << " refsect1(versions).informaltable.tbody missing" << std::endl;
 				return;
 			}
 
-			for (const auto&[node, name] : NodeNameIterator(tbody)) {
-				if (name == "row") {
-					Node entry = firstChild(node, "entry");
+			for (const auto&[node, name, token] : NodeNameIterator(tbody)) {
+				if (token == XmlName::Row) {
+					Node entry = firstChild(node, XmlName::Entry);
 					Node xiinclude = entry.next_sibling("xi:include");
 
 					if (!entry || !xiinclude) {
-						std::cout << "@" << _name << " refsect1(versions).informaltable.tbody.row.entry or xi:include missing" << std::endl;
+						Log_() << " refsect1(versions).informaltable.tbody.row.entry or xi:include missing" << std::endl;
 						return;
 					}
 
-					Node functionNode = firstChild(entry, "function");
+					Node functionNode = firstChild(entry, XmlName::Function);
 					if (!functionNode) {
 						continue;
 					}
 
 					std::string function = functionNode.text().as_string();
-					std::string xpointer = firstAttribute(xiinclude, "xpointer").value();
+					std::string xpointer = firstAttribute(xiinclude, XmlName::Xpointer).value();
 
 					const auto&[match, major, minor] = ctre::match<regexVersion>(xpointer);
 					if (!match) {
-						std::cout << "@" << _name << " version xpointer doesn't match regex" << std::endl;
+						Log_() << " version xpointer doesn't match regex" << std::endl;
 						return;
 					}
 
-					versions.versions[function] = std::string(major) + "." + std::string(minor);
+					versions.Set(function, std::string(major) + "." + std::string(minor));
 				} else {
-					std::cout << "@" << _name << " Unknown node: refsect1(versions).informaltable.tbody." << name << std::endl;
+					Log_() << " Unknown node: refsect1(versions).informaltable.tbody." << name << std::endl;
 				}
 			}
 		}
@@ -374,747 +954,742 @@ void Refpage::ParseRefsect1Versions_(Node refsect1) {
 }
 
 void Refpage::ParseRefsect1Seealso_(Node refsect1) {
+	PhaseTimer timer(Phase::SeeAlso);
+
 	if (include.see_also) {
-		auto& seealso = _refsect_seealso.emplace();
+		auto& seealso = _refsect_seealso.emplace(Allocator_());
 		ParseAbstractText_(refsect1, seealso.contents);
 	}
 }
 
 void Refpage::ParseRefsect1Copyright_(Node refsect1) {
+	PhaseTimer timer(Phase::Copyright);
+
 	if (include.copyright) {
-		auto& copyright = _refsect_copyright.emplace();
+		auto& copyright = _refsect_copyright.emplace(Allocator_());
 		ParseAbstractText_(refsect1, copyright.contents);
 	}
 }
 
 void Refpage::ParseAbstractText_(Node parent, impl_abstract_text& text) {
-	for (const auto& [node, name] : NodeNameIterator(parent)) {
-		std::string value = ParseAbstractTextNode_(node, name);
+	// every element is rendered into the same buffer, and only copied out once
+	std::string output;
 
-		if (!value.empty()) {
-			text.elements.push_back(std::move(value));
+	for (const auto& [node, name, token] : NodeNameIterator(parent)) {
+		output.clear();
+		ParseAbstractTextNode_(node, name, token, output);
+
+		if (!output.empty()) {
+			text.elements.emplace_back(output);
+			tokenizeText(output, text.tokens);
+			text.tokenEnds.push_back(static_cast<std::uint32_t>(text.tokens.size()));
 		}
 	}
 }
 
-std::string Refpage::ParseAbstractTextNode_(Node node, const std::string_view& name) {
-	if (name == "title") {
-		return ""; /* ignored */
-	} else if (name == "para") {
-		return ParsePara_(node);
-	} else if (name == "xi:include") {
-		return ParseInclude_(node);
-	} else if (name == "parameter") {
-		return ParseValueNode_(node, name, "<code>", "</code>");
-	} else if (name == "constant") {
-		return ParseValueNode_(node, name, "<code>", "</code>");
-	} else if (name == "function") {
-		return ParseValueNode_(node, name, "<b><code>", "</code></b>");
-	} else if (name == "code") {
-		return ParseValueNode_(node, name, "<code>", "</code>");
-	} else if (name == "superscript") {
-		return ParseValueNode_(node, name, "<sup>", "</sup>");
-	} else if (name == "emphasis") {
-		return ParseEmphasis_(node);
-	} else if (name == "trademark") {
-		return ParseTrademark_(node);
-	} else if (name == "citerefentry") {
-		return ParseCiterefentry_(node);
-	} else if (name == "link") {
-		return ParseLink_(node);
-	} else if (name == "footnote") {
-		return ""; /* ignored for now */
-	} else if (name == "informaltable") {
-		return ParseInformaltable_(node);
-	} else if (name == "table") {
-		return ParseTable_(node);
-	} else if (name == "programlisting") {
-		return ParseProgramlisting_(node);
-	} else if (name == "itemizedlist") {
-		return ParseItemizedlist_(node);
-	} else if (name == "variablelist") {
-		return ParseVariablelistGlosslist_(node);
-	} else if (name == "glosslist") {
-		return ParseVariablelistGlosslist_(node);
-	} else if (name == "inlineequation") {
-		return ParseInlineequation_(node);
-	} else if (name == "informalequation") {
-		return ParseInformalequation_(node);
-	} else {
-		std::cout << "@" << _name << " Unknown text node: " << name << std::endl;
-		return "";
+void Refpage::ParseAbstractTextNode_(Node node, std::string_view name, XmlName token, std::string& output) {
+	switch (token) {
+		case XmlName::Title:
+			break; /* ignored */
+		case XmlName::Para:
+			ParsePara_(node, output);
+			break;
+		case XmlName::XiInclude:
+			ParseInclude_(node, output);
+			break;
+		case XmlName::Parameter:
+			ParseValueNode_(node, name, "<code>", "</code>", output);
+			break;
+		case XmlName::Constant:
+			ParseValueNode_(node, name, "<code>", "</code>", output);
+			break;
+		case XmlName::Function:
+			ParseValueNode_(node, name, "<b><code>", "</code></b>", output);
+			break;
+		case XmlName::Code:
+			ParseValueNode_(node, name, "<code>", "</code>", output);
+			break;
+		case XmlName::Superscript:
+			ParseValueNode_(node, name, "<sup>", "</sup>", output);
+			break;
+		case XmlName::Emphasis:
+			ParseEmphasis_(node, output);
+			break;
+		case XmlName::Trademark:
+			ParseTrademark_(node, output);
+			break;
+		case XmlName::Citerefentry:
+			ParseCiterefentry_(node, output);
+			break;
+		case XmlName::Link:
+			ParseLink_(node, output);
+			break;
+		case XmlName::Footnote:
+			break; /* ignored for now */
+		case XmlName::Informaltable:
+			ParseInformaltable_(node, output);
+			break;
+		case XmlName::Table:
+			ParseTable_(node, output);
+			break;
+		case XmlName::Programlisting:
+			ParseProgramlisting_(node, output);
+			break;
+		case XmlName::Itemizedlist:
+			ParseItemizedlist_(node, output);
+			break;
+		case XmlName::Variablelist:
+		case XmlName::Glosslist:
+			ParseVariablelistGlosslist_(node, output);
+			break;
+		case XmlName::Inlineequation:
+			ParseInlineequation_(node, output);
+			break;
+		case XmlName::Informalequation:
+			ParseInformalequation_(node, output);
+			break;
+		default:
+			Log_() << " Unknown text node: " << name << std::endl;
+			break;
 	}
 }
 
-std::string Refpage::ParseValueNode_(Node node, const std::string_view& name, const std::string& begin, const std::string& end) {
-	return begin + ParseText_(node) + end;
+void Refpage::ParseValueNode_(Node node, const std::string_view& name, std::string_view begin, std::string_view end, std::string& output) {
+	output.append(begin);
+	ParseText_(node, output);
+	output.append(end);
 }
 
-std::string Refpage::ParseInclude_(Node include) {
-	auto attr = firstAttribute(include, "href");
+void Refpage::ParseInclude_(Node include, std::string& output) {
+	PhaseTimer timer(Phase::Include);
+
+	auto attr = firstAttribute(include, XmlName::Href);
 	if (!attr) {
-		std::cout << "@" << _name << " xi:include without href" << std::endl;
-		return "";
+		Log_() << " xi:include without href" << std::endl;
+		return;
 	}
 
-	std::string filename = attr.value();
-	std::filesystem::path path = _dir / filename;
-	std::ifstream file(path.string());
+	std::string href = std::filesystem::path(attr.value()).lexically_normal().generic_string();
 
-	std::string fileContents(
-			(std::istreambuf_iterator<char>(file)),
-			std::istreambuf_iterator<char>());
-	char* buf = &fileContents[0];
+	const auto& fragment = includeCache.Get(href, [this](const auto& path, auto& fragment) {
+		fragment.buffer = _refpages->Map(path.generic_string());
 
-	Document doc;
-	doc.load_string(buf);
+		{
+			PhaseTimer timer(Phase::XmlLoad);
+			fragment.document.load_buffer_inplace(fragment.buffer.Data(), fragment.buffer.Size(), xmlParseOptions, pugi::encoding_utf8);
+		}
 
-	Node node = doc.first_child();
-	return ParseAbstractTextNode_(node, node.name());
-}
+		// The fragment is rendered once for all refpages that include it, so
+		// keep its diagnostics and includes to repeat them for every one of
+		// them.
+		std::stringstream diagnostics;
+		std::ostream* capture = std::exchange(_capture, &diagnostics);
+		std::vector<std::string> includes = std::exchange(_includes, {});
 
-std::string Refpage::ParsePara_(Node para) {
-	return ParseValueNode_(para, "para", "<p>", "</p>");
-}
+		Node node = fragment.document.first_child();
+		ParseAbstractTextNode_(node, node.name(), xmlName(node.name()), fragment.text);
+		fragment.diagnostics = diagnostics.str();
+		fragment.includes = std::exchange(_includes, std::move(includes));
 
-std::string Refpage::ParseText_(Node para) {
-	constexpr ctll::fixed_string regexWhitespace = R"(\r?\n\s*)";
-	constexpr ctll::fixed_string regexSpaces = R"(^( *).*?( *)$)";
-	constexpr ctll::fixed_string regexTex = R"((\${1,2})([^$]+)(?:\1)(.*))";
+		_capture = capture;
+	});
 
-	std::stringstream ss;
+	_includes.push_back(std::move(href));
+	_includes.insert(_includes.end(), fragment.includes.begin(), fragment.includes.end());
 
-	for (const auto& [node, name] : NodeNameIterator(para)) {
-		std::string value = node.text().as_string();
+	RepeatDiagnostics_(fragment.diagnostics);
+	output += fragment.text;
+}
 
-		if (name == "") {
-			auto result = ctre::search<regexWhitespace>(value);
-			bool hasWhitespace = result;
+void Refpage::RepeatDiagnostics_(std::string_view diagnostics) {
+	// diagnostics that were captured while rendering something once for all
+	// pages are repeated for this page
+	while (!diagnostics.empty()) {
+		auto end = diagnostics.find('\n');
+		Log_() << diagnostics.substr(0, end) << std::endl;
+		diagnostics.remove_prefix(end == std::string_view::npos ? diagnostics.size() : end + 1);
+	}
+}
 
-			while (hasWhitespace) {
-				auto iter = value.erase(result.get<0>().begin(), result.get<0>().end());
-				value.insert(iter, ' ');
+void Refpage::ParsePara_(Node para, std::string& output) {
+	ParseValueNode_(para, "para", "<p>", "</p>", output);
+}
 
-				result = ctre::search<regexWhitespace>(value);
-				hasWhitespace = result;
-			}
+void Refpage::ParseText_(Node para, std::string& output) {
+	std::size_t start = output.size();
 
-			ss << value;
+	for (const auto& [node, name, token] : NodeNameIterator(para)) {
+		if (token == XmlName::Text) {
+			appendCollapsed(output, node.text().as_string());
 		} else {
-			ss << ParseAbstractTextNode_(node, name);
+			ParseAbstractTextNode_(node, name, token, output);
 		}
 	}
 
-	// erase leading and trailing spaces
-	std::string result = ss.str();
+	// leave out leading and trailing spaces
+	std::size_t begin = output.find_first_not_of(' ', start);
 
-	if (auto [found, begin, end] = ctre::match<regexSpaces>(result); found) {
-		result.erase(end.begin(), end.end());
-		result.erase(begin.begin(), begin.end());
+	if (begin == std::string::npos) {
+		output.resize(start);
+		return;
 	}
 
-	// parse TeX symbols
-	std::string_view input = result;
-	std::stringstream output;
+	output.resize(output.find_last_not_of(' ') + 1);
+	output.erase(start, begin - start);
+
+	// parse TeX symbols. Few paragraphs have them, so only those are copied to
+	// be rendered again.
+	if (!findTeX(std::string_view(output).substr(start))) {
+		return;
+	}
 
-	while (!input.empty()) {
-		auto [match, type, contents, rest] = ctre::search<regexTex>(input);
+	std::string text = output.substr(start);
+	std::string_view input = text;
+	output.resize(start);
 
-		if (match) {
-			output << std::string_view(input.begin(), match.begin());
-			output << ParseLaTeX_(type, contents);
-			input = rest;
-		} else {
-			output << input;
-			break;
-		}
+	while (auto tex = findTeX(input)) {
+		output.append(input.substr(0, tex->begin));
+		ParseLaTeX_(tex->type, tex->contents, output);
+		input.remove_prefix(tex->end);
 	}
 
-	return output.str();
+	output.append(input);
 }
 
-std::string Refpage::ParseEmphasis_(Node emphasis) {
-	std::string openTag;
-	std::string closeTag;
+void Refpage::ParseEmphasis_(Node emphasis, std::string& output) {
+	std::string_view openTag;
+	std::string_view closeTag;
 
-	if (auto attr = firstAttribute(emphasis, "role"); attr) {
-		std::string role = attr.value();
+	if (auto attr = firstAttribute(emphasis, XmlName::Role); attr) {
+		std::string_view role = attr.value();
 
 		if (role == "bold") {
 			openTag = "<b>";
 			closeTag = "</b>";
 		} else {
-			std::cout << "@" << _name << " Unknown emphasis role attribute: " << role << std::endl;
+			Log_() << " Unknown emphasis role attribute: " << role << std::endl;
 		}
 	} else {
 		openTag = "<i>";
 		closeTag = "</i>";
 	}
 
-	return ParseValueNode_(emphasis, "emphasis", openTag, closeTag);
+	ParseValueNode_(emphasis, "emphasis", openTag, closeTag, output);
 }
 
-std::string Refpage::ParseTrademark_(Node trademark) {
-	if (auto attr = firstAttribute(trademark, "class"); attr) {
+void Refpage::ParseTrademark_(Node trademark, std::string& output) {
+	if (auto attr = firstAttribute(trademark, XmlName::Class); attr) {
 		std::string_view value = attr.value();
 
 		if (value == "copyright") {
-			return "(c)";
+			output += "(c)";
 		} else {
-			std::cout << "@" << _name << " Unknown trademark class: " << value << std::endl;
+			Log_() << " Unknown trademark class: " << value << std::endl;
 		}
 	} else {
-		std::cout << "@" << _name << " Trademark node without class attribute" << std::endl;
+		Log_() << " Trademark node without class attribute" << std::endl;
 	}
-
-	return "";
 }
 
-std::string Refpage::ParseCiterefentry_(Node citerefentry) {
-	if (Node child = GetOnlyChild_(citerefentry, "citerefentry", "refentrytitle"); child) {
-		return ParseValueNode_(child, "refentrytitle", "<b>", "</b>");
+void Refpage::ParseCiterefentry_(Node citerefentry, std::string& output) {
+	if (Node child = GetOnlyChild_(citerefentry, "citerefentry", XmlName::Refentrytitle); child) {
+		ParseValueNode_(child, "refentrytitle", "<b>", "</b>", output);
 	}
-
-	return "";
 }
 
-std::string Refpage::ParseLink_(Node link) {
-	if (auto attr = firstAttribute(link, "xlink:href"); attr) {
-		std::string_view value = attr.value();
-		return ParseValueNode_(link, "link", "<a href=\"" + std::string(attr.value()) + "\">", "</a>");
+void Refpage::ParseLink_(Node link, std::string& output) {
+	if (auto attr = firstAttribute(link, XmlName::XlinkHref); attr) {
+		output += "<a href=\"";
+		output += attr.value();
+		output += "\">";
+		ParseText_(link, output);
+		output += "</a>";
 	} else {
-		std::cout << "@" << _name << " Link node without xlink:href attribute" << std::endl;
+		Log_() << " Link node without xlink:href attribute" << std::endl;
 	}
-
-	return "";
 }
 
-std::string Refpage::ParseInformaltable_(Node informaltable) {
-	return ParseTable_(informaltable);
+void Refpage::ParseInformaltable_(Node informaltable, std::string& output) {
+	ParseTable_(informaltable, output);
 }
 
-std::string Refpage::ParseTable_(Node table) {
-	std::stringstream ss;
-	ss << "<table style=\"border:1px solid; border-spacing:0px; margin:8px;\">\n";
+void Refpage::ParseTable_(Node table, std::string& output) {
+	output += "<table style=\"border:1px solid; border-spacing:0px; margin:8px;\">\n";
 
-	for (const auto& [node, name] : NodeNameIterator(table)) {
-		if (name == "title") {
-			ss << ParseValueNode_(node, name, "<title>", "</title>\n");
-		} else if (name == "tgroup") {
-			ParseTableGroup_(node, ss);
+	for (const auto& [node, name, token] : NodeNameIterator(table)) {
+		if (token == XmlName::Title) {
+			ParseValueNode_(node, name, "<title>", "</title>\n", output);
+		} else if (token == XmlName::Tgroup) {
+			ParseTableGroup_(node, output);
 		} else {
-			std::cout << "@" << _name << " Unknown node: (informal?)table." << name << std::endl;
+			Log_() << " Unknown node: (informal?)table." << name << std::endl;
 		}
 	}
 
-	ss << "</table>\n";
-	return ss.str();
+	output += "</table>\n";
 }
 
-void Refpage::ParseTableGroup_(Node tgroup, std::stringstream& ss) {
-	for (const auto& [node, name] : NodeNameIterator(tgroup)) {
-		if (name == "colspec") {
+void Refpage::ParseTableGroup_(Node tgroup, std::string& output) {
+	for (const auto& [node, name, token] : NodeNameIterator(tgroup)) {
+		if (token == XmlName::Colspec) {
 			continue; /* ignored */
-		} else if (name == "thead" || name == "tbody") {
-			ParseTableRows_(node, name, ss);
+		} else if (token == XmlName::Thead || token == XmlName::Tbody) {
+			ParseTableRows_(node, token == XmlName::Thead, output);
 		} else {
-			std::cout << "@" << _name << " Unknown node: (informal?)table.tgroup." << name << std::endl;
+			Log_() << " Unknown node: (informal?)table.tgroup." << name << std::endl;
 		}
 	}
 }
 
-void Refpage::ParseTableRows_(Node node, const std::string_view& name, std::stringstream& ss) {
-	bool head = name == "thead";
-
-	for (const auto& [node, name] : NodeNameIterator(node)) {
-		if (name == "row") {
-			ss << "<tr>\n";
-			ParseInformaltableRow_(node, head, ss);
-			ss << "</tr>\n";
+void Refpage::ParseTableRows_(Node node, bool head, std::string& output) {
+	for (const auto& [node, name, token] : NodeNameIterator(node)) {
+		if (token == XmlName::Row) {
+			output += "<tr>\n";
+			ParseInformaltableRow_(node, head, output);
+			output += "</tr>\n";
 		} else {
-			std::cout << "@" << _name << " Unknown node: (informal?)table.tgroup." << name << "." << name << std::endl;
+			Log_() << " Unknown node: (informal?)table.tgroup." << name << "." << name << std::endl;
 		}
 	}
 }
 
-void Refpage::ParseInformaltableRow_(Node row, bool head, std::stringstream& ss) {
-	for (const auto& [node, name] : NodeNameIterator(row)) {
-		if (name == "entry") {
-			ss << "<";
-			ss << (head ? "th" : "td");
-			ss << " style=\"border:1px solid; padding:5px; margin:0px;\">\n";
-			ss << ParseText_(node);
-			ss << "</";
-			ss << (head ? "th" : "td");
-			ss << ">\n";
+void Refpage::ParseInformaltableRow_(Node row, bool head, std::string& output) {
+	for (const auto& [node, name, token] : NodeNameIterator(row)) {
+		if (token == XmlName::Entry) {
+			output += head ? "<th" : "<td";
+			output += " style=\"border:1px solid; padding:5px; margin:0px;\">\n";
+			ParseText_(node, output);
+			output += head ? "</th>\n" : "</td>\n";
 		} else {
-			std::cout << "@" << _name << " Unknown row node: " << name << std::endl;
+			Log_() << " Unknown row node: " << name << std::endl;
 		}
 	}
 }
 
-std::string Refpage::ParseProgramlisting_(Node programlisting) {
-	constexpr ctll::fixed_string regexLine = R"(([^\r\n]*)(\r?\n)?(.*))";
-
-	std::stringstream contents;
+void Refpage::ParseProgramlisting_(Node programlisting, std::string& output) {
+	std::size_t start = output.size();
 
-	for (const auto& [node, name] : NodeNameIterator(programlisting)) {
-		if (name == "") {
-			contents << node.text().as_string();
+	for (const auto& [node, name, token] : NodeNameIterator(programlisting)) {
+		if (token == XmlName::Text) {
+			output += node.text().as_string();
 		} else {
-			contents << ParseAbstractTextNode_(node, name);
+			ParseAbstractTextNode_(node, name, token, output);
 		}
 	}
 
-	std::stringstream ss;
-	std::string valueString = contents.str();
-	std::string_view value = valueString;
+	// every line of the listing becomes a <pre> of its own
+	std::string contents = output.substr(start);
+	std::string_view value = contents;
+	output.resize(start);
 
 	while (!value.empty()) {
-		const auto& [match, line, linefeed, rest] = ctre::match<regexLine>(value);
-		std::string_view lineValue = line;
-		ss << "<pre>" << lineValue << "</pre>" << std::endl;
-		value = rest;
-	}
-
-	return ss.str();
-}
+		std::size_t end = std::min(value.find_first_of("\r\n"), value.size());
 
-std::string Refpage::ParseItemizedlist_(Node itemizedlist) {
-	std::stringstream ss;
-	ss << "<ul>\n";
+		output += "<pre>";
+		output.append(value.substr(0, end));
+		output += "</pre>\n";
 
-	for (const auto& [node, name] : NodeNameIterator(itemizedlist)) {
-		if (name == "listitem") {
-			ss << ParseValueNode_(node, name, "<li>", "</li>\n");
-		} else {
-			std::cout << "@" << _name << " Unknown node: itemizedlist." << name << std::endl;
+		value.remove_prefix(end);
+		if (value.starts_with("\r\n")) {
+			value.remove_prefix(2);
+		} else if (!value.empty()) {
+			value.remove_prefix(1);
 		}
 	}
-
-	ss << "</ul>\n";
-	return ss.str();
 }
 
-std::string Refpage::ParseVariablelistGlosslist_(Node variablelist) {
-	std::stringstream ss;
-	ss << "<table>\n";
+void Refpage::ParseItemizedlist_(Node itemizedlist, std::string& output) {
+	output += "<ul>\n";
 
-	for (const auto&[node, name] : NodeNameIterator(variablelist)) {
-		if (name == "varlistentry" || name == "glossentry") {
-			ss << ParseVarlistentryGlossentry_(node);
+	for (const auto& [node, name, token] : NodeNameIterator(itemizedlist)) {
+		if (token == XmlName::Listitem) {
+			ParseValueNode_(node, name, "<li>", "</li>\n", output);
 		} else {
-			std::cout << "@" << _name << " Unknown node: " << variablelist.name() << "." << name << std::endl;
+			Log_() << " Unknown node: itemizedlist." << name << std::endl;
 		}
 	}
 
-	ss << "</table>";
-	return ss.str();
+	output += "</ul>\n";
 }
 
-std::string Refpage::ParseVarlistentryGlossentry_(Node varlistentry) {
-	std::vector<std::string> terms;
-	impl_abstract_text text;
+void Refpage::ParseVariablelistGlosslist_(Node variablelist, std::string& output) {
+	output += "<table>\n";
 
-	for (const auto& [node, name] : NodeNameIterator(varlistentry)) {
-		if (name == "term" || name == "glossterm") {
-			terms.push_back(ParseValueNode_(node, name, "<i><code>", "</code></i>"));
-		} else if (name == "listitem" || name == "glossdef") {
-			ParseAbstractText_(node, text);
+	for (const auto&[node, name, token] : NodeNameIterator(variablelist)) {
+		if (token == XmlName::Varlistentry || token == XmlName::Glossentry) {
+			ParseVarlistentryGlossentry_(node, output);
 		} else {
-			std::cout << "@" << _name << " Unknown node: " << varlistentry.name() << "." << name << std::endl;
+			Log_() << " Unknown node: " << variablelist.name() << "." << name << std::endl;
 		}
 	}
 
-	std::stringstream ss;
-	ss << "<tr>\n";
-	ss << "<th>\n";
+	output += "</table>";
+}
+
+void Refpage::ParseVarlistentryGlossentry_(Node varlistentry, std::string& output) {
+	// the terms come before the definitions in an entry, so both are rendered
+	// in the order they are in
+	output += "<tr>\n";
+	output += "<th>\n";
 
 	bool first = true;
-	for (const auto& term : terms) {
-		if (!first) {
-			ss << ", ";
-		}
+	bool definitions = false;
 
-		ss << term;
-		first = false;
-	}
+	for (const auto& [node, name, token] : NodeNameIterator(varlistentry)) {
+		if (token == XmlName::Term || token == XmlName::Glossterm) {
+			if (!first) {
+				output += ", ";
+			}
+
+			ParseValueNode_(node, name, "<i><code>", "</code></i>", output);
+			first = false;
+		} else if (token == XmlName::Listitem || token == XmlName::Glossdef) {
+			if (!definitions) {
+				output += "</th>\n";
+				output += "<td>&nbsp;&nbsp;</th>\n";
+				output += "<td>\n";
+				definitions = true;
+			}
+
+			for (const auto& [node, name, token] : NodeNameIterator(node)) {
+				std::size_t size = output.size();
+				ParseAbstractTextNode_(node, name, token, output);
 
-	ss << "</th>\n";
-	ss << "<td>&nbsp;&nbsp;</th>\n";
-	ss << "<td>\n";
+				if (output.size() != size) {
+					output += '\n';
+				}
+			}
+		} else {
+			Log_() << " Unknown node: " << varlistentry.name() << "." << name << std::endl;
+		}
+	}
 
-	for (const auto& t : text.elements) {
-		ss << t << std::endl;
+	if (!definitions) {
+		output += "</th>\n";
+		output += "<td>&nbsp;&nbsp;</th>\n";
+		output += "<td>\n";
 	}
 
-	ss << "</td>\n";
-	ss << "</tr>\n";
-	return ss.str();
+	output += "</td>\n";
+	output += "</tr>\n";
 }
 
-std::string Refpage::ParseInlineequation_(Node inlineequation) {
-	if (Node mmlMath = GetOnlyChild_(inlineequation, "inlineequation", "mml:math"); mmlMath) {
-		std::stringstream ss;
+void Refpage::ParseInlineequation_(Node inlineequation, std::string& output) {
+	PhaseTimer timer(Phase::MathML);
 
-		for (const auto& [node, name] : NodeNameIterator(mmlMath)) {
-			ss << ParseAbstractMathNode_(node, name);
-		}
+	Node mmlMath = GetOnlyChild_(inlineequation, "inlineequation", XmlName::MmlMath);
+	if (!mmlMath) {
+		return;
+	}
 
-		std::string value = ss.str();
+	std::size_t start = output.size();
+	_mathTable = false;
 
-		// an inline table can only be displayed if the entire thing is in a
-		// table. So if we have a table, enclose the equation.
-		bool table = hasDescendant(inlineequation, "mml:mtable");
-		if (table) {
-			value = "<table><tr><td> " + value + " </td></tr></table>";
-		}
+	for (const auto& [node, name, token] : NodeNameIterator(mmlMath)) {
+		ParseAbstractMathNode_(node, name, token, output);
+	}
 
-		return value;
-	}
-
-	return "";
-}
-
-std::string Refpage::ParseInformalequation_(Node informalequation) {
-	return ParseInlineequation_(informalequation);
-}
-
-std::string Refpage::ParseAbstractMathNode_(Node node, const std::string_view& name) {
-	if (name == "") {
-		return node.text().as_string();
-	} else if (name == "mml:mi") {
-		return ParseMmlmi_(node);
-	} else if (name == "mml:mn") {
-		return ParseMmlmn_(node);
-	} else if (name == "mml:mo") {
-		return ParseMmlmo_(node);
-	} else if (name == "mml:mtext") {
-		return ParseMmlmtext_(node);
-	} else if (name == "mml:mfenced") {
-		return ParseMmlmfenced_(node);
-	} else if (name == "mml:mrow") {
-		return ParseMmlmrow_(node);
-	} else if (name == "mml:msup") {
-		return ParseMmlmsup_(node);
-	} else if (name == "mml:msub") {
-		return ParseMmlmsub_(node);
-	} else if (name == "mml:mfrac") {
-		return ParseMmlmfrac_(node);
-	} else if (name == "mml:mtable") {
-		return ParseMmlmtable_(node);
-	} else if (name == "mml:mtr") {
-		return ParseMmlmtr_(node);
-	} else if (name == "mml:mtd") {
-		return ParseMmlmtd_(node);
-	} else if (name == "mml:mspace") {
-		return ParseMmlmspace_(node);
-	} else {
-		std::cout << "@" << _name << " Unknown math node: " << name << std::endl;
-		return "";
+	// an inline table can only be displayed if the entire thing is in a
+	// table. So if we had a table, enclose the equation.
+	if (_mathTable) {
+		output.insert(start, "<table><tr><td> ");
+		output += " </td></tr></table>";
 	}
 }
 
-std::string Refpage::ParseMathValue_(Node parent) {
-	std::stringstream ss;
+void Refpage::ParseInformalequation_(Node informalequation, std::string& output) {
+	ParseInlineequation_(informalequation, output);
+}
 
-	for (const auto& [node, name] : NodeNameIterator(parent)) {
-		ss << ParseAbstractMathNode_(node, name);
+void Refpage::ParseAbstractMathNode_(Node node, std::string_view name, XmlName token, std::string& output) {
+	switch (token) {
+		case XmlName::Text:
+			output += node.text().as_string();
+			break;
+		case XmlName::MmlMi:
+			ParseMmlmi_(node, output);
+			break;
+		case XmlName::MmlMn:
+			ParseMmlmn_(node, output);
+			break;
+		case XmlName::MmlMo:
+			ParseMmlmo_(node, output);
+			break;
+		case XmlName::MmlMtext:
+			ParseMmlmtext_(node, output);
+			break;
+		case XmlName::MmlMfenced:
+			ParseMmlmfenced_(node, output);
+			break;
+		case XmlName::MmlMrow:
+			ParseMmlmrow_(node, output);
+			break;
+		case XmlName::MmlMsup:
+			ParseMmlmsup_(node, output);
+			break;
+		case XmlName::MmlMsub:
+			ParseMmlmsub_(node, output);
+			break;
+		case XmlName::MmlMfrac:
+			ParseMmlmfrac_(node, output);
+			break;
+		case XmlName::MmlMtable:
+			ParseMmlmtable_(node, output);
+			break;
+		case XmlName::MmlMtr:
+			ParseMmlmtr_(node, output);
+			break;
+		case XmlName::MmlMtd:
+			ParseMmlmtd_(node, output);
+			break;
+		case XmlName::MmlMspace:
+			ParseMmlmspace_(node, output);
+			break;
+		default:
+			Log_() << " Unknown math node: " << name << std::endl;
+			break;
 	}
+}
 
-	return ss.str();
+void Refpage::ParseAbstractMathNode_(Node node, std::string& output) {
+	std::string_view name = node.name();
+	ParseAbstractMathNode_(node, name, xmlName(name), output);
 }
 
-std::string Refpage::ParseMmlmi_(Node mmlmi) {
-	std::string value = ParseMathValue_(mmlmi);
-	std::string open;
-	std::string close;
+void Refpage::ParseMathValue_(Node parent, std::string& output) {
+	for (const auto& [node, name, token] : NodeNameIterator(parent)) {
+		ParseAbstractMathNode_(node, name, token, output);
+	}
+}
 
-	if (auto attr = firstAttribute(mmlmi, "mathvariant"); attr) {
-		std::string mathvariant = attr.value();
+void Refpage::ParseMmlmi_(Node mmlmi, std::string& output) {
+	if (auto attr = firstAttribute(mmlmi, XmlName::Mathvariant); attr) {
+		std::string_view mathvariant = attr.value();
 
 		if (mathvariant == "italic") {
-			open = "<i>";
-			close = "</i>";
+			output += "<i>";
+			ParseMathValue_(mmlmi, output);
+			output += "</i>";
 		} else {
-			std::cout << "@" << _name << " Unknown mml:mi mathvariant value: " << mathvariant << std::endl;
+			ParseMathValue_(mmlmi, output);
+			Log_() << " Unknown mml:mi mathvariant value: " << mathvariant << std::endl;
 		}
-	} else if (value.size() == 1) {
-		open = "<i>";
-		close = "</i>";
-	} else {
-		open = "";
-		close = "";
+
+		return;
 	}
 
-	return open + value + close;
-}
+	// a single character identifier is in italics
+	std::size_t start = output.size();
+	ParseMathValue_(mmlmi, output);
 
-std::string Refpage::ParseMmlmn_(Node mmlmn) {
-	return ParseMathValue_(mmlmn);
+	if (output.size() - start == 1) {
+		output.insert(start, "<i>");
+		output += "</i>";
+	}
 }
 
-std::string Refpage::ParseMmlmo_(Node mmlmo) {
-	return ParseMathValue_(mmlmo);
+void Refpage::ParseMmlmn_(Node mmlmn, std::string& output) {
+	ParseMathValue_(mmlmn, output);
 }
 
-std::string Refpage::ParseMmlmtext_(Node mmlmtext) {
-	std::string value = ParseMathValue_(mmlmtext);
-	std::string open;
-	std::string close;
+void Refpage::ParseMmlmo_(Node mmlmo, std::string& output) {
+	ParseMathValue_(mmlmo, output);
+}
 
-	if (auto attr = firstAttribute(mmlmtext, "mathvariant"); attr) {
-		std::string mathvariant = attr.value();
+void Refpage::ParseMmlmtext_(Node mmlmtext, std::string& output) {
+	if (auto attr = firstAttribute(mmlmtext, XmlName::Mathvariant); attr) {
+		std::string_view mathvariant = attr.value();
 
 		if (mathvariant == "italic") {
-			open = "<i>";
-			close = "</i>";
+			output += "<i>";
+			ParseMathValue_(mmlmtext, output);
+			output += "</i>";
 		} else {
-			std::cout << "@" << _name << " Unknown mml:mtext mathvariant value: " << mathvariant << std::endl;
+			ParseMathValue_(mmlmtext, output);
+			Log_() << " Unknown mml:mtext mathvariant value: " << mathvariant << std::endl;
 		}
 	} else {
-		open = "";
-		close = "";
+		ParseMathValue_(mmlmtext, output);
 	}
-
-	return open + value + close;
 }
 
-std::string Refpage::ParseMmlmfenced_(Node mmlmfenced) {
-	std::string value = ParseMathValue_(mmlmfenced);
-	std::string open = "(";
-	std::string close = ")";
+void Refpage::ParseMmlmfenced_(Node mmlmfenced, std::string& output) {
+	std::string_view open = "(";
+	std::string_view close = ")";
 
-	if (auto openAttr = firstAttribute(mmlmfenced, "open"); openAttr) {
+	if (auto openAttr = firstAttribute(mmlmfenced, XmlName::Open); openAttr) {
 		open = openAttr.value();
 	}
 
-	if (auto closeAttr = firstAttribute(mmlmfenced, "close"); closeAttr) {
+	if (auto closeAttr = firstAttribute(mmlmfenced, XmlName::Close); closeAttr) {
 		close = closeAttr.value();
 	}
 
-	std::stringstream ss;
-	ss << open;
+	output.append(open);
 	bool first = true;
 
-	for (const auto& [node, name] : NodeNameIterator(mmlmfenced)) {
+	for (const auto& [node, name, token] : NodeNameIterator(mmlmfenced)) {
 		if (!first) {
-			ss << ",&nbsp";
+			output += ",&nbsp";
 		}
 
-		ss << ParseAbstractMathNode_(node, name);
+		ParseAbstractMathNode_(node, name, token, output);
 		first = false;
 	}
 
-	ss << close;
-	return ss.str();
+	output.append(close);
 }
 
-std::string Refpage::ParseMmlmrow_(Node mmlmrow) {
-	return ParseMathValue_(mmlmrow);
+void Refpage::ParseMmlmrow_(Node mmlmrow, std::string& output) {
+	ParseMathValue_(mmlmrow, output);
 }
 
-std::string Refpage::ParseMmlmsup_(Node mmlmsup) {
+void Refpage::ParseMmlmsup_(Node mmlmsup, std::string& output) {
 	auto base = mmlmsup.first_child();
 	auto superscript = base.next_sibling();
-	return ParseAbstractMathNode_(base, base.name()) + "<sup>" + ParseAbstractMathNode_(superscript, superscript.name()) + "</sup> ";
+
+	ParseAbstractMathNode_(base, output);
+	output += "<sup>";
+	ParseAbstractMathNode_(superscript, output);
+	output += "</sup> ";
 }
 
-std::string Refpage::ParseMmlmsub_(Node mmlmsub) {
+void Refpage::ParseMmlmsub_(Node mmlmsub, std::string& output) {
 	auto base = mmlmsub.first_child();
 	auto subscript = base.next_sibling();
-	return ParseAbstractMathNode_(base, base.name()) + "<sub>" + ParseAbstractMathNode_(subscript, subscript.name()) + "</sub> ";
+
+	ParseAbstractMathNode_(base, output);
+	output += "<sub>";
+	ParseAbstractMathNode_(subscript, output);
+	output += "</sub> ";
 }
 
-std::string Refpage::ParseMmlmfrac_(Node mmlmsub) {
+void Refpage::ParseMmlmfrac_(Node mmlmsub, std::string& output) {
 	auto numerator = mmlmsub.first_child();
 	auto denominator = numerator.next_sibling();
-	return " <sup>" + ParseAbstractMathNode_(numerator, numerator.name()) + "</sup>/<sub>" + ParseAbstractMathNode_(denominator, denominator.name()) + "</sub> ";
+
+	output += " <sup>";
+	ParseAbstractMathNode_(numerator, output);
+	output += "</sup>/<sub>";
+	ParseAbstractMathNode_(denominator, output);
+	output += "</sub> ";
 }
 
-std::string Refpage::ParseMmlmtable_(Node mmlmtable) {
-	return " </rd><td><table>\n" + ParseMathValue_(mmlmtable) + "</table></rd>\n<td> ";
+void Refpage::ParseMmlmtable_(Node mmlmtable, std::string& output) {
+	_mathTable = true;
+	output += " </rd><td><table>\n";
+	ParseMathValue_(mmlmtable, output);
+	output += "</table></rd>\n<td> ";
 }
 
-std::string Refpage::ParseMmlmtr_(Node mmlmtr) {
-	return "<tr>\n" + ParseMathValue_(mmlmtr) + "</tr>\n";
+void Refpage::ParseMmlmtr_(Node mmlmtr, std::string& output) {
+	output += "<tr>\n";
+	ParseMathValue_(mmlmtr, output);
+	output += "</tr>\n";
 }
 
-std::string Refpage::ParseMmlmtd_(Node mmlmtd) {
-	return "<td>" + ParseMathValue_(mmlmtd) + "</td>\n";
+void Refpage::ParseMmlmtd_(Node mmlmtd, std::string& output) {
+	output += "<td>";
+	ParseMathValue_(mmlmtd, output);
+	output += "</td>\n";
 }
 
-std::string Refpage::ParseMmlmspace_(Node) {
-	return "&nbsp;&nbsp;&nbsp;&nbsp;";
+void Refpage::ParseMmlmspace_(Node, std::string& output) {
+	output += "&nbsp;&nbsp;&nbsp;&nbsp;";
 }
 
-std::string Refpage::ParseLaTeX_(std::string_view type, std::string_view input) {
+void Refpage::ParseLaTeX_(std::string_view type, std::string_view input, std::string& output) {
+	PhaseTimer timer(Phase::LaTeX);
+
 	bool texinline = type == "$";
-	std::stringstream ss;
 
 	if (!texinline) {
-		ss << "<center>";
+		output += "<center>";
 	}
 
-	ss << ParseInnerLaTeX_(input);
+	output.append(ParseInnerLaTeX_(input));
 
 	if (!texinline) {
-		ss << "</center>";
-	}
-	return ss.str();
-}
-
-std::string Refpage::ParseInnerLaTeX_(std::string_view input) {
-	// Ok. this is bad. However, there is not much LaTeX code in the refpages so
-	// parsing LaTeX would be extremely overkill. For now, this will have to do.
-
-	if (input == "first") {
-		return "<i>first</i>";
-	} else if (input == "first + count - 1") {
-		return "<i>first</i> + <i>count</i> - 1";
-	} else if (input == "z_{min} \\leq z_c \\leq w_c") {
-		return "<i>z<sub>min</sub></i> &le; <i>z<sub>c</sub></i> &le; <i>w<sub>c</sub></i>";
-	} else if (input == "z_{min} = -w_c") {
-		return "<i>z<sub>min</sub></i> = -<i>w<sub>c</sub></i>";
-	} else if (input == "z_{min} = 0") {
-		return "<i>z<sub>min</sub></i> = 0";
-	} else if (input == "y_d") {
-		return "<i>y<sub>d</sub></i>";
-	} else if (input == "y_d = { { f \\times y_c } \\over w_c }") {
-		return "<i>y<sub>d</sub></i> = <sup><i>f</i> &times; <i>y<sub>c</sub></i></sup>/<sub><i>w<sub>c</sub></i></sub>";
-	} else if (input == "f = 1") {
-		return "<i>f</i> = 1";
-	} else if (input == "f = -1") {
-		return "<i>f</i> = -1";
-	} else if (input == "z_w") {
-		return "<i>z<sub>w</sub></i>";
-	} else if (input == "z_w = s \\times z_d + b") {
-		return "<i>z<sub>w</sub></i> = <i>s</i> &times; <i>z<sub>d</sub> + <i>b</i>";
-	} else if (input == "s = { { f - n } \\over 2 }") {
-		return "<i>s</i> = <sup><i>f</i> - <i>n</i></sup>/<sub>2</sub>";
-	} else if (input == "b = { {n + f} \\over 2 }") {
-		return "<i>b</i> = <sup><i>n</i> + <i>f</i></sup>/<sub>2</sub>";
-	} else if (input == "s = f - n") {
-		return "<i>s</i> = <i>f</i> - <i>n</i>";
-	} else if (input == "b = n") {
-		return "<i>b</i> = <i>n</i>";
-	} else if (input == "n") {
-		return "<i>n</i>";
-	} else if (input == "f") {
-		return "<i>f</i>";
-	} else if (input == "readOffset+size") {
-		return "<i>readOffset</i> + <i>size</i>";
-	} else if (input == "writeOffset+size") {
-		return "<i>writeOffset</i> + <i>size</i>";
-	} else if (input == "[0,1]") {
-		return "[0,1]";
-	} else if (input == "m") {
-		return "<i>m</i>";
-	} else if (input == "log_2") {
-		return "log<sub>2</sub>";
-	} else if (input == " face = k \\bmod 6. ") {
-		return " <i>face</i> = <i>k</i> mod 6. ";
-	} else if (input == R"( layer = \left\lfloor { layer \over 6 } \right\rfloor)") {
-		return " <i>layer</i> = &lfloor; <i>layer</i>/6 &rfloor;";
-	} else if (input == "level_{base} + 1") {
-		return "<i>level<sub>base</sub></i> + 1";
-	} else if (input == "q") {
-		return "<i>q</i>";
-	} else if (input == "level_{base}") {
-		return "<i>level<sub>base</sub></i>";
-	} else if (input == "level_{base}+1") {
-		return "<i>level<sub>base</sub></i> + 1";
-	} else if (input == "k") {
-		return "<i>k</i>";
-	} else if (input == "(0,0)") {
-		return "(0,0)";
-	} else if (input == R"( \left\lfloor { size \over { components \times sizeof(base\_type) } } \right\rfloor )") {
-		return "&lfloor; <sup><i>size</i></sup>/<sub><i>components</i> &times; sizeof(<i>base_type</i>)</sub> &rfloor;";
-	} else if (input == "size") {
-		return "<i>size</i>";
-	} else if (input == "components") {
-		return "<i>components</i>";
-	} else if (input == "base\\_type") {
-		return "<i>base_type</i>";
-	} else if (input == "first + count") {
-		return "<i>first</i> + <i>count</i>";
-	} else if (input == "N") {
-		return "<i>N</i>";
-	}  else if (input == "offset + size") {
-		return "<i>offset</i> + <i>size</i>";
-	} else if (input == "readOffset + size") {
-		return "<i>readOffset</i> + <i>size</i>";
-	} else if (input == "writeOffset + size") {
-		return "<i>writeOffset</i> + <i>size</i>";
-	} else if (input == "[readOffset,readOffset+size)") {
-		return "[<i>readOffset</i>, <i>readOffset</i> + <i>size</i>)";
-	} else if (input == "[writeOffset,writeOffset+size)") {
-		return "[<i>writeOffset</i>, <i>writeOffset</i> + <i>size</i>)";
-	} else if (input == "offset + length") {
-		return "<i>offset</i> + <i>length</i>";
-	} else {
-		std::cout << "@" << _name << " Unrecognized LaTeX math: " << input << std::endl;
+		output += "</center>";
+	}
+}
+
+std::string_view Refpage::ParseInnerLaTeX_(std::string_view input) {
+	const std::optional<std::string>* html = latexMemo.Get(input);
+
+	// a fragment whose hash collides with another is rendered every time
+	thread_local std::optional<std::string> uncached;
+
+	if (!html) {
+		uncached = renderLaTeX(input);
+		html = &uncached;
+	}
+
+	if (!*html) {
+		Log_() << " Unrecognized LaTeX math: " << input << std::endl;
 		return "<code>LaTeX</code>";
 	}
+
+	return **html;
 }
 
 void Refpage::ParseParameters_(Node refsect1, impl_refsect_parameters& parameters) {
-	for (const auto& [node, name] : NodeNameIterator(refsect1)) {
-		if (name == "variablelist") {
+	for (const auto& [node, name, token] : NodeNameIterator(refsect1)) {
+		if (token == XmlName::Variablelist) {
 			ParseVariablelist_(node, parameters);
-		} else if (name == "title") {
-			Node function = firstChild(node, "function");
+		} else if (token == XmlName::Title) {
+			Node function = firstChild(node, XmlName::Function);
 			if (function) {
-				parameters.impl_for_function.emplace(function.text().as_string());
+				parameters.impl_for_function.emplace(function.text().as_string(), Allocator_());
 			}
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsect1(parameters)." << name << std::endl;
+			Log_() << " Unknown node: refsect1(parameters)." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseVariablelist_(Node variablelist, impl_refsect_parameters& parameters) {
-	for (const auto& [node, name] : NodeNameIterator(variablelist)) {
-		if (name == "varlistentry") {
+	for (const auto& [node, name, token] : NodeNameIterator(variablelist)) {
+		if (token == XmlName::Varlistentry) {
 			auto& varlistentry = parameters.varlistentries.emplace_back();
 			ParseVarlistentry_(node, varlistentry);
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsect1(parameters).variablelist." << name << std::endl;
+			Log_() << " Unknown node: refsect1(parameters).variablelist." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseVarlistentry_(Node varlistentry, impl_varlistentry& value) {
-	for (const auto& [node, name] : NodeNameIterator(varlistentry)) {
-		if (name == "term") {
+	for (const auto& [node, name, token] : NodeNameIterator(varlistentry)) {
+		if (token == XmlName::Term) {
 			ParseTerm_(node, value);
-		} else if (name == "listitem") {
+		} else if (token == XmlName::Listitem) {
 			ParseAbstractText_(node, value.listitem.contents);
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsect1(parameters).variablelist.varlistentry." << name << std::endl;
+			Log_() << " Unknown node: refsect1(parameters).variablelist.varlistentry." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseTerm_(Node term, impl_varlistentry& varlistentry) {
-	for (const auto& [node, name] : NodeNameIterator(term)) {
-		if (name == "") {
+	for (const auto& [node, name, token] : NodeNameIterator(term)) {
+		if (token == XmlName::Text) {
 			continue; /* ignored */
-		} else if (name == "parameter") {
+		} else if (token == XmlName::Parameter) {
 			varlistentry.terms.emplace_back(node.text().as_string());
 		} else {
-			std::cout << "@" << _name << " Unknown node: refsect1(parameters).variablelist.varlistentry.term." << name << std::endl;
+			Log_() << " Unknown node: refsect1(parameters).variablelist.varlistentry.term." << name << std::endl;
 		}
 	}
 }
 
 void Refpage::ParseDescription_(Node refsect1, impl_refsect_description& description) {
 	// parse the optional function name
-	for (const auto& [node, name] : NodeNameIterator(refsect1)) {
-		if (name == "title") {
-			Node function = firstChild(node, "function");
+	for (const auto& [node, name, token] : NodeNameIterator(refsect1)) {
+		if (token == XmlName::Title) {
+			Node function = firstChild(node, XmlName::Function);
 			if (function) {
-				description.impl_for_function.emplace(function.text().as_string());
+				description.impl_for_function.emplace(function.text().as_string(), Allocator_());
 			}
 		}
 	}
@@ -1123,15 +1698,15 @@ void Refpage::ParseDescription_(Node refsect1, impl_refsect_description& descrip
 	ParseAbstractText_(refsect1, description.contents);
 }
 
-void Refpage::GenerateHeader_(std::ostream& output, const impl_funcprototype& prototype) const {
+void Refpage::GenerateHeader_(std::ostream& output, const impl_funcprototype& prototype, const includes& options, RenderedComments& rendered) const {
 	constexpr ctll::fixed_string regexConstPointer = R"(\s*const\s+([a-zA-Z_]\w*)\s*(\*)\s*(?:const\s*(\*)\s*)?)";
-	output << std::endl;
+	output << '\n';
 
 	// Generate the comments for this prototype
-	GenerateComments_(output, prototype);
+	GenerateComments_(output, prototype, options, rendered);
 
 	// Output the function prototype
-	if (gl1.find(prototype.funcdef.function) == gl1.end()) {
+	if (!prototype.gl1) {
 		output << "GLWR_INLINE ";
 	}
 
@@ -1149,11 +1724,11 @@ void Refpage::GenerateHeader_(std::ostream& output, const impl_funcprototype& pr
 
 	output << ")";
 
-	if (gl1.find(prototype.funcdef.function) == gl1.end()) {
+	if (!prototype.gl1) {
 		// later than OpenGL 1, so give a definition
 		std::string_view nongl(prototype.funcdef.function.begin() + 2, prototype.funcdef.function.end());
 
-		output << " {" << std::endl;
+		output << " {\n";
 		output << "\t";
 
 		if (prototype.funcdef.type != "void") {
@@ -1179,79 +1754,123 @@ void Refpage::GenerateHeader_(std::ostream& output, const impl_funcprototype& pr
 			first = false;
 		}
 
-		output << ");" << std::endl;
-		output << "}" << std::endl;
+		output << ");\n";
+		output << "}\n";
 	} else {
 		// OpenGL 1 function, so only the declaration
-		output << ";" << std::endl;
+		output << ";\n";
 	}
 }
 
-void Refpage::GenerateComments_(std::ostream& output, const Refpage::impl_funcprototype& prototype) const {
+template<typename F>
+const std::string& Refpage::Memoize_(std::optional<RenderedSection>& rendered, const F& render) const {
+	// The diagnostics of rendering the section are kept with it, and written
+	// again for every prototype the section is used for, as if it was
+	// rendered again.
+	if (!rendered) {
+		OutputBuffer output;
+		std::stringstream diagnostics;
+		std::ostream* log = std::exchange(_log, &diagnostics);
+
+		render(output);
+
+		_log = log;
+		rendered.emplace(std::string(output.View()), diagnostics.str());
+	}
+
+	if (!rendered->diagnostics.empty()) {
+		*_log << rendered->diagnostics << std::flush;
+	}
+
+	return rendered->text;
+}
+
+void Refpage::GenerateComments_(std::ostream& output, const Refpage::impl_funcprototype& prototype, const includes& options, RenderedComments& rendered) const {
 	// brief
-	if (include.link || include.brief) {
-		output << "///" << std::endl;
-		output << "/// \\brief" << std::endl;
+	if (options.link || options.brief) {
+		SectionCounter counter(output, Section::Brief);
 
-		if (include.link) {
-			output << "/// <a href=\"https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/" << _name << ".xhtml\">" << _name << "</a> " << std::endl;
-		}
+		output << Memoize_(rendered.brief, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\brief\n";
 
-		std::string brief = _refnamediv.refpurpose;
+			if (options.link) {
+				section << "/// <a href=\"https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/" << _name << ".xhtml\">" << _name << "</a> \n";
+			}
 
-		if (include.link && include.brief) {
-			std::string_view ndash = "&ndash; ";
-			brief.insert(brief.begin(), ndash.begin(), ndash.end());
-		}
+			std::string brief(_refnamediv.refpurpose);
 
-		if (include.brief) {
-			GenerateText_(output, brief);
-		}
+			if (options.link && options.brief) {
+				std::string_view ndash = "&ndash; ";
+				brief.insert(brief.begin(), ndash.begin(), ndash.end());
+			}
+
+			if (options.brief) {
+				GenerateText_(section, brief);
+			}
+		});
 	}
 
 	// version
-	if (_refsect_versions) {
-		auto iter = _refsect_versions->versions.find(prototype.funcdef.function);
-		if (iter != _refsect_versions->versions.end()) {
-			output << "///" << std::endl;
-			output << "/// \\since OpenGL " << iter->second << std::endl;
+	if (options.version && _refsect_versions) {
+		SectionCounter counter(output, Section::Version);
+
+		if (const String* version = _refsect_versions->Find(prototype.funcdef.function)) {
+			output << "///\n";
+			output << "/// \\since OpenGL " << *version << '\n';
 		}
 	}
 
 	// description
-	if (_refsect_description) {
-		const impl_refsect_description& description =
-				_refsect_description_2.has_value() && _refsect_description_2->impl_for_function.value() == prototype.funcdef.function
-						? _refsect_description_2.value()
-						: _refsect_description.value();
+	if (options.description && _refsect_description) {
+		SectionCounter counter(output, Section::Description);
+
+		bool second = _refsect_description_2.has_value() && _refsect_description_2->impl_for_function.value() == prototype.funcdef.function;
+		const impl_refsect_description& description = second ? _refsect_description_2.value() : _refsect_description.value();
 
-		output << "///" << std::endl;
-		output << "/// \\description" << std::endl;
-		GenerateText_(output, description.contents);
+		output << Memoize_(second ? rendered.description2 : rendered.description, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\description\n";
+			GenerateText_(section, description.contents, rendered.sharedDocs);
+		});
 	}
 
 	// examples
-	if (_refsect_examples) {
-		output << "///" << std::endl;
-		output << "/// \\examples" << std::endl;
-		GenerateText_(output, _refsect_examples->contents);
+	if (options.examples && _refsect_examples) {
+		SectionCounter counter(output, Section::Examples);
+
+		output << Memoize_(rendered.examples, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\examples\n";
+			GenerateText_(section, _refsect_examples->contents, rendered.sharedDocs);
+		});
 	}
 
 	// notes
-	if (_refsect_notes) {
-		output << "///" << std::endl;
-		output << "/// \\notes" << std::endl;
-		GenerateText_(output, _refsect_notes->contents);
+	if (options.notes && _refsect_notes) {
+		SectionCounter counter(output, Section::Notes);
+
+		output << Memoize_(rendered.notes, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\notes\n";
+			GenerateText_(section, _refsect_notes->contents, rendered.sharedDocs);
+		});
 	}
 
 	// parameters
-	if (_refsect_parameters) {
-		const impl_refsect_parameters& parameters =
-				_refsect_parameters_2.has_value() && _refsect_parameters_2->impl_for_function.value() == prototype.funcdef.function
-						? _refsect_parameters_2.value()
-						: _refsect_parameters.value();
+	if (options.parameters && _refsect_parameters) {
+		SectionCounter counter(output, Section::Parameters);
+
+		bool second = _refsect_parameters_2.has_value() && _refsect_parameters_2->impl_for_function.value() == prototype.funcdef.function;
+		const impl_refsect_parameters& parameters = second ? _refsect_parameters_2.value() : _refsect_parameters.value();
 
-		for (const auto& varlistentry : parameters.varlistentries) {
+		// which terms are documented depends on the prototype, but the list
+		// items do not
+		auto& listitems = second ? rendered.parameters2 : rendered.parameters;
+		listitems.resize(parameters.varlistentries.size());
+
+		for (std::size_t i = 0; i < parameters.varlistentries.size(); i++) {
+			const auto& varlistentry = parameters.varlistentries[i];
 			bool first = true;
 
 			for (const auto& term : varlistentry.terms) {
@@ -1260,7 +1879,7 @@ void Refpage::GenerateComments_(std::ostream& output, const Refpage::impl_funcpr
 				}
 
 				if (first) {
-					output << "///" << std::endl;
+					output << "///\n";
 					output << "/// \\param";
 				} else {
 					output << ',';
@@ -1271,117 +1890,108 @@ void Refpage::GenerateComments_(std::ostream& output, const Refpage::impl_funcpr
 			}
 
 			if (!first) {
-				output << std::endl;
-				GenerateText_(output, varlistentry.listitem.contents);
+				output << '\n';
+				output << Memoize_(listitems[i], [&](std::ostream& section) {
+					GenerateText_(section, varlistentry.listitem.contents, rendered.sharedDocs);
+				});
 			}
 		}
 	}
 
 	// errors
-	if (_refsect_errors) {
-		output << "///" << std::endl;
-		output << "/// \\errors" << std::endl;
-		GenerateText_(output, _refsect_errors->contents);
+	if (options.errors && _refsect_errors) {
+		SectionCounter counter(output, Section::Errors);
+
+		output << Memoize_(rendered.errors, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\errors\n";
+			GenerateText_(section, _refsect_errors->contents, rendered.sharedDocs);
+		});
 	}
 
 	// associated gets
-	if (_refsect_associatedgets) {
-		output << "///" << std::endl;
-		output << "/// \\associated_gets" << std::endl;
-		GenerateText_(output, _refsect_associatedgets->contents);
+	if (options.associated_gets && _refsect_associatedgets) {
+		SectionCounter counter(output, Section::AssociatedGets);
+
+		output << Memoize_(rendered.associatedgets, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\associated_gets\n";
+			GenerateText_(section, _refsect_associatedgets->contents, rendered.sharedDocs);
+		});
 	}
 
 	// see also
-	if (_refsect_seealso) {
-		output << "///" << std::endl;
-		output << "/// \\see_also" << std::endl;
-		GenerateText_(output, _refsect_seealso->contents);
-	}
+	if (options.see_also && _refsect_seealso) {
+		SectionCounter counter(output, Section::SeeAlso);
 
-	// copyright
-	if (_refsect_copyright) {
-		output << "///" << std::endl;
-		output << "/// \\copyright" << std::endl;
-		GenerateText_(output, _refsect_copyright->contents);
+		output << Memoize_(rendered.seealso, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\see_also\n";
+			GenerateText_(section, _refsect_seealso->contents, rendered.sharedDocs);
+		});
 	}
 
-	output << "///" << std::endl;
-}
+	// copyright
+	if (options.copyright && _refsect_copyright) {
+		SectionCounter counter(output, Section::Copyright);
 
-void Refpage::GenerateText_(std::ostream& output, const Refpage::impl_abstract_text& text) const {
-	for (const auto& element : text.elements) {
-		GenerateText_(output, element);
+		output << Memoize_(rendered.copyright, [&](std::ostream& section) {
+			section << "///\n";
+			section << "/// \\copyright\n";
+			GenerateText_(section, _refsect_copyright->contents, rendered.sharedDocs);
+		});
 	}
-}
 
-void Refpage::GenerateText_(std::ostream& output, std::string_view text) const {
-	constexpr ctll::fixed_string regexToken = R"(( *)([^\w< ]*(?:[\w'\-]+|<(code|sub|sup|i|b)>[^ <]{0,64}</\3>|<pre>.*?</pre>|<.*?>)?[^\w< \n]*)(.*))";
+	output << "///\n";
+}
 
-	// ignore any spaces at the beginning
-	while (!text.empty() && *text.begin() == ' ') {
-		text = text.substr(1);
-	}
+void Refpage::GenerateText_(std::ostream& output, const Refpage::impl_abstract_text& text, bool sharedDocs) const {
+	for (std::size_t i = 0; i < text.elements.size(); i++) {
+		std::string_view element = text.elements[i];
+		std::span<const TextToken> tokens = text.Tokens(i);
 
-	// main text loop
-	unsigned lineWidth = 0;
+		// every paragraph is rendered once per run, and reused for every page
+		// that has the same paragraph
+		const DocPool::Block* block = docPool.Get(element, [tokens](std::string_view source, DocPool::Block& block) {
+			OutputBuffer rendered;
+			block.failed = wrapTokens(rendered, source, tokens);
+			block.text = rendered.View();
+		});
 
-	while (!text.empty()) {
-		// new line -> output the new line
-		if (*text.begin() == '\n') {
-			if (lineWidth == 0) {
-				output << "/// " << std::endl;
-			} else {
-				output << std::endl;
-				lineWidth = 0;
+		if (!block) {
+			if (std::string_view left = wrapTokens(output, element, tokens); !left.empty()) {
+				Log_() << ": token generation failed. Left: " << left << std::endl;
 			}
 
-			text = text.substr(1);
 			continue;
 		}
 
-		// get the first token, its following whitespace, and the rest
-		const auto& [match, spacesMatch, tokenMatch, _, restMatch] = ctre::match<regexToken>(text);
-
-		if (!match) {
-			std::cout << "@" << _name << ": token generation failed. Left: " << text << std::endl;
-			return;
+		if (!block->failed.empty()) {
+			Log_() << ": token generation failed. Left: " << block->failed << std::endl;
 		}
 
-		// retrieve the groups
-		std::string_view token = tokenMatch;
-		std::string_view spaces = spacesMatch;
-
-		if (!token.empty()) {
-			// output the token
-			bool space = !spaces.empty();
-
-			if (lineWidth == 0) {
-				output << "///";
-				space = true;
-			} else if (lineWidth + token.length() + space > 77) {
-				output << std::endl;
-				output << "///";
-				lineWidth = 0;
-				space = true;
-			}
-
-			if (space) {
-				output << ' ';
-			}
-
-			output << token;
-			lineWidth += token.length() + space;
+		if (sharedDocs) {
+			output << docReferencePrefix << hashToString(block->hash) << '\n';
+		} else {
+			output << block->text;
 		}
-
-		text = restMatch;
 	}
+}
 
-	// end the final line
-	if (lineWidth > 0) {
-		output << std::endl;
+void Refpage::GenerateText_(std::ostream& output, std::string_view text) const {
+	if (std::string_view left = WrapText_(output, text); !left.empty()) {
+		Log_() << ": token generation failed. Left: " << left << std::endl;
 	}
 }
 
+std::string_view Refpage::WrapText_(std::ostream& output, std::string_view text) {
+	thread_local TextTokens tokens;
+
+	tokens.clear();
+	tokenizeText(text, tokens);
+	return wrapTokens(output, text, tokens);
+}
+
 bool Refpage::PrototypeHasParameter_(const Refpage::impl_funcprototype& prototype, std::string_view param) {
 	for (const auto& paramdef : prototype.paramdefs) {
 		if (paramdef.parameter == param) {
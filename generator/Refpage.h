@@ -6,117 +6,303 @@
 
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
 #include <optional>
-#include <unordered_map>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "Options.h"
+#include "TextTokens.h"
 #include "XmlHelper.h"
 
+class RefpageSource;
+
 class Refpage {
 
 public:
+	/*
+	 * The model of a page is allocated from an arena of its own, which is
+	 * released at once when the page is destroyed. Every part of the model
+	 * takes the allocator of the arena, and passes it on to its members.
+	 */
+	using Allocator = std::pmr::polymorphic_allocator<>;
+	using String = std::pmr::string;
+
+	template<typename T>
+	using Vector = std::pmr::vector<T>;
+
 	struct impl_copyright {
-		std::string year;
-		std::string holder;
+		using allocator_type = Allocator;
+
+		explicit impl_copyright(const Allocator& alloc) : year(alloc), holder(alloc) {}
+		impl_copyright(impl_copyright&& other, const Allocator& alloc) : year(std::move(other.year), alloc), holder(std::move(other.holder), alloc) {}
+
+		String year;
+		String holder;
 	};
 
 	struct impl_refmeta {
-		std::string refentrytitle;
-		std::string manvolnum;
+		explicit impl_refmeta(const Allocator& alloc) : refentrytitle(alloc), manvolnum(alloc) {}
+
+		String refentrytitle;
+		String manvolnum;
 	};
 
 	struct impl_refnamediv {
-		std::optional<std::string> refdescriptor;
-		std::vector<std::string> refnames;
-		std::string refpurpose;
+		explicit impl_refnamediv(const Allocator& alloc) : refnames(alloc), refpurpose(alloc) {}
+
+		std::optional<String> refdescriptor;
+		Vector<String> refnames;
+		String refpurpose;
 	};
 
 	struct impl_paramdef {
-		std::string type;
-		std::string parameter;
+		using allocator_type = Allocator;
+
+		explicit impl_paramdef(const Allocator& alloc) : type(alloc), parameter(alloc) {}
+		impl_paramdef(impl_paramdef&& other, const Allocator& alloc) : type(std::move(other.type), alloc), parameter(std::move(other.parameter), alloc) {}
+
+		String type;
+		String parameter;
 	};
 
 	struct impl_funcdef {
-		std::string type;
-		std::string function;
+		using allocator_type = Allocator;
+
+		explicit impl_funcdef(const Allocator& alloc) : type(alloc), function(alloc) {}
+		impl_funcdef(impl_funcdef&& other, const Allocator& alloc) : type(std::move(other.type), alloc), function(std::move(other.function), alloc) {}
+
+		String type;
+		String function;
 	};
 
 	struct impl_funcprototype {
+		using allocator_type = Allocator;
+
+		explicit impl_funcprototype(const Allocator& alloc) : funcdef(alloc), paramdefs(alloc) {}
+		impl_funcprototype(impl_funcprototype&& other, const Allocator& alloc) :
+				funcdef(std::move(other.funcdef), alloc),
+				paramdefs(std::move(other.paramdefs), alloc),
+				gl1(other.gl1) {}
+
 		impl_funcdef funcdef;
-		std::vector<impl_paramdef> paramdefs;
+		Vector<impl_paramdef> paramdefs;
+
+		// whether the function is in OpenGL 1.1
+		bool gl1 = false;
 	};
 
 	struct impl_refsynopsisdiv {
-		std::vector<impl_funcprototype> funcprototypes;
+		explicit impl_refsynopsisdiv(const Allocator& alloc) : funcprototypes(alloc) {}
+
+		Vector<impl_funcprototype> funcprototypes;
 	};
 
 	struct impl_abstract_text {
-		std::vector<std::string> elements;
+		using allocator_type = Allocator;
+
+		explicit impl_abstract_text(const Allocator& alloc) : elements(alloc), tokens(alloc), tokenEnds(alloc) {}
+		impl_abstract_text(impl_abstract_text&& other, const Allocator& alloc) :
+				elements(std::move(other.elements), alloc),
+				tokens(std::move(other.tokens), alloc),
+				tokenEnds(std::move(other.tokenEnds), alloc) {}
+
+		/*
+		 * The tokens of an element, which point into its text.
+		 */
+		std::span<const TextToken> Tokens(std::size_t element) const {
+			std::size_t begin = element == 0 ? 0 : tokenEnds[element - 1];
+			return std::span(tokens).subspan(begin, tokenEnds[element] - begin);
+		}
+
+		// the rendered elements
+		Vector<String> elements;
+
+		// the tokens of all elements one after another, and where the tokens
+		// of every element end
+		TextTokens tokens;
+		Vector<std::uint32_t> tokenEnds;
 	};
 
 	struct impl_listitem {
+		using allocator_type = Allocator;
+
+		explicit impl_listitem(const Allocator& alloc) : contents(alloc) {}
+		impl_listitem(impl_listitem&& other, const Allocator& alloc) : contents(std::move(other.contents), alloc) {}
+
 		impl_abstract_text contents;
 	};
 
 	struct impl_varlistentry {
-		std::vector<std::string> terms;
+		using allocator_type = Allocator;
+
+		explicit impl_varlistentry(const Allocator& alloc) : terms(alloc), listitem(alloc) {}
+		impl_varlistentry(impl_varlistentry&& other, const Allocator& alloc) : terms(std::move(other.terms), alloc), listitem(std::move(other.listitem), alloc) {}
+
+		Vector<String> terms;
 		impl_listitem listitem;
 	};
 
 	struct impl_refsect_parameters {
-		std::optional<std::string> impl_for_function;
-		std::vector<impl_varlistentry> varlistentries;
+		explicit impl_refsect_parameters(const Allocator& alloc) : varlistentries(alloc) {}
+
+		std::optional<String> impl_for_function;
+		Vector<impl_varlistentry> varlistentries;
 	};
 
-	struct impl_refsect_parameters_2 : public impl_refsect_parameters {};
+	struct impl_refsect_parameters_2 : public impl_refsect_parameters {
+		using impl_refsect_parameters::impl_refsect_parameters;
+	};
 
 	struct impl_refsect_description {
-		std::optional<std::string> impl_for_function;
+		explicit impl_refsect_description(const Allocator& alloc) : contents(alloc) {}
+
+		std::optional<String> impl_for_function;
 		impl_abstract_text contents;
 	};
 
-	struct impl_refsect_description_2 : public impl_refsect_description {};
+	struct impl_refsect_description_2 : public impl_refsect_description {
+		using impl_refsect_description::impl_refsect_description;
+	};
 
 	struct impl_refsect_examples {
+		explicit impl_refsect_examples(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
 	struct impl_refsect_notes {
+		explicit impl_refsect_notes(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
 	struct impl_refsect_errors {
+		explicit impl_refsect_errors(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
 	struct impl_refsect_associatedgets {
+		explicit impl_refsect_associatedgets(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
+	/*
+	 * The versions by function, sorted by function. A page has only a handful
+	 * of them, so a sorted vector is both smaller and faster than a hash map.
+	 */
 	struct impl_refsect_versions {
-		std::unordered_map<std::string, std::string> versions;
+		explicit impl_refsect_versions(const Allocator& alloc) : versions(alloc) {}
+
+		const String* Find(std::string_view function) const;
+		void Set(std::string_view function, std::string_view version);
+
+		Vector<std::pair<String, String>> versions;
 	};
 
 	struct impl_refsect_seealso {
+		explicit impl_refsect_seealso(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
 	struct impl_refsect_copyright {
+		explicit impl_refsect_copyright(const Allocator& alloc) : contents(alloc) {}
+
 		impl_abstract_text contents;
 	};
 
-	Refpage(std::filesystem::path dir, std::istream& input, std::string name);
-
-	void GenerateHeader(std::ostream& output) const;
+	/*
+	 * Parses the refpage from the input. The input is parsed in place, so its
+	 * contents are destroyed. Only the sections enabled in the global include
+	 * options are parsed. Diagnostics about the refpage are written to log.
+	 */
+	Refpage(const RefpageSource& refpages, std::span<char> input, std::string name, std::ostream& log = std::cout);
+
+	// The containers of a moved refpage keep using its arena. Assigning would
+	// free the arena before the containers in it are reassigned.
+	Refpage(Refpage&&) = default;
+	Refpage& operator=(Refpage&&) = delete;
+
+	/*
+	 * Generates the header with the documentation sections enabled in options.
+	 * Sections that were not parsed are left out regardless. With sharedDocs,
+	 * every paragraph is a reference to its block in the docs pool instead, to
+	 * be resolved once all headers are generated.
+	 */
+	void GenerateHeader(std::ostream& output, const includes& options = include, bool sharedDocs = false) const;
+
+	/*
+	 * Serializes the parsed model of the refpage into a compact binary form.
+	 */
+	std::string Serialize() const;
+
+	/*
+	 * Restores a refpage from the result of Serialize(). Returns an empty
+	 * optional if the data is malformed.
+	 */
+	static std::optional<Refpage> Deserialize(const RefpageSource& refpages, std::string name, std::string_view data, std::ostream& log = std::cout);
+
+	const std::string& Name() const { return _name; }
+
+	/*
+	 * Sets where diagnostics are written to from now on.
+	 */
+	void SetLog(std::ostream& log) { _log = &log; }
+
+	/*
+	 * The files that were included while parsing, relative to the refpages
+	 * directory, in the order they were first included.
+	 */
+	const std::vector<std::string>& Includes() const { return _includes; }
 
 private:
-	void Set_(const char* node, std::string& str, std::string_view value);
-	Node GetOnlyChild_(Node node, const std::string_view& name, std::string_view child);
+	friend class RefpageBenchmark;
+
+	/*
+	 * The rendered comment blocks of the sections that are the same for every
+	 * prototype of a page. GenerateHeader renders each of them the first time
+	 * a prototype needs it, and reuses it for the other prototypes.
+	 */
+	// a rendered comment section, with the diagnostics of rendering it
+	struct RenderedSection {
+		std::string text;
+		std::string diagnostics;
+	};
+
+	struct RenderedComments {
+		std::optional<RenderedSection> brief;
+		std::optional<RenderedSection> description;
+		std::optional<RenderedSection> description2;
+		std::optional<RenderedSection> examples;
+		std::optional<RenderedSection> notes;
+		std::optional<RenderedSection> errors;
+		std::optional<RenderedSection> associatedgets;
+		std::optional<RenderedSection> seealso;
+		std::optional<RenderedSection> copyright;
+
+		// the list items of the parameters, by varlistentry
+		std::vector<std::optional<RenderedSection>> parameters;
+		std::vector<std::optional<RenderedSection>> parameters2;
+
+		// whether paragraphs are rendered as references to the docs pool
+		bool sharedDocs = false;
+	};
+
+	Refpage(const RefpageSource& refpages, std::string name, std::ostream& log, std::size_t arenaSize);
+
+	std::ostream& Log_() const;
+	Allocator Allocator_() const { return _arena.get(); }
+	void Set_(const char* node, String& str, std::string_view value);
+	Node GetOnlyChild_(Node node, const std::string_view& name, XmlName child);
 
 	void Parse_(const Document& doc);
 	void ParseRefentry_(Node refentry);
-	void ParseNode_(Node node);
+	void ParseNode_(Node node, std::string_view name, XmlName token);
 
 	void ParseInfo_(Node info);
 	void ParseRefmeta_(Node refmeta);
@@ -143,45 +329,52 @@ private:
 	void ParseRefsect1Copyright_(Node refsect1);
 
 	void ParseAbstractText_(Node parent, impl_abstract_text& text);
-	std::string ParseAbstractTextNode_(Node node, const std::string_view& name);
-	std::string ParseValueNode_(Node node, const std::string_view& name, const std::string& begin, const std::string& end);
-	std::string ParseInclude_(Node include);
-	std::string ParsePara_(Node para);
-	std::string ParseText_(Node node);
-	std::string ParseEmphasis_(Node emphasis);
-	std::string ParseTrademark_(Node trademark);
-	std::string ParseCiterefentry_(Node citerefentry);
-	std::string ParseLink_(Node link);
-	std::string ParseInformaltable_(Node informaltable);
-	std::string ParseTable_(Node table);
-	void ParseTableGroup_(Node tgroup, std::stringstream& ss);
-	void ParseTableRows_(Node node, const std::string_view& name, std::stringstream& ss);
-	void ParseInformaltableRow_(Node row, bool head, std::stringstream& ss);
-	std::string ParseProgramlisting_(Node programlisting);
-	std::string ParseItemizedlist_(Node itemizedlist);
-	std::string ParseVariablelistGlosslist_(Node variablelist);
-	std::string ParseVarlistentryGlossentry_(Node varlistentry);
-	std::string ParseInlineequation_(Node inlineequation);
-	std::string ParseInformalequation_(Node inlineequation);
-
-	std::string ParseAbstractMathNode_(Node node, const std::string_view& name);
-	std::string ParseMathValue_(Node parent);
-	std::string ParseMmlmi_(Node mmlmi);
-	std::string ParseMmlmn_(Node mmlmn);
-	std::string ParseMmlmo_(Node mmlmo);
-	std::string ParseMmlmtext_(Node mmlmtext);
-	std::string ParseMmlmfenced_(Node mmlmfenced);
-	std::string ParseMmlmrow_(Node mmlmrow);
-	std::string ParseMmlmsup_(Node mmlmsup);
-	std::string ParseMmlmsub_(Node mmlmsub);
-	std::string ParseMmlmfrac_(Node mmlmfrac);
-	std::string ParseMmlmtable_(Node mmlmtable);
-	std::string ParseMmlmtr_(Node mmlmtr);
-	std::string ParseMmlmtd_(Node mmlmtd);
-	static std::string ParseMmlmspace_(Node mmlmspace);
-
-	std::string ParseLaTeX_(std::string_view type, std::string_view input);
-	std::string ParseInnerLaTeX_(std::string_view input);
+
+	/*
+	 * The text and math parsers append what they render to output, so that
+	 * all of an element is rendered into one buffer.
+	 */
+	void ParseAbstractTextNode_(Node node, std::string_view name, XmlName token, std::string& output);
+	void ParseValueNode_(Node node, const std::string_view& name, std::string_view begin, std::string_view end, std::string& output);
+	void ParseInclude_(Node include, std::string& output);
+	void RepeatDiagnostics_(std::string_view diagnostics);
+	void ParsePara_(Node para, std::string& output);
+	void ParseText_(Node node, std::string& output);
+	void ParseEmphasis_(Node emphasis, std::string& output);
+	void ParseTrademark_(Node trademark, std::string& output);
+	void ParseCiterefentry_(Node citerefentry, std::string& output);
+	void ParseLink_(Node link, std::string& output);
+	void ParseInformaltable_(Node informaltable, std::string& output);
+	void ParseTable_(Node table, std::string& output);
+	void ParseTableGroup_(Node tgroup, std::string& output);
+	void ParseTableRows_(Node node, bool head, std::string& output);
+	void ParseInformaltableRow_(Node row, bool head, std::string& output);
+	void ParseProgramlisting_(Node programlisting, std::string& output);
+	void ParseItemizedlist_(Node itemizedlist, std::string& output);
+	void ParseVariablelistGlosslist_(Node variablelist, std::string& output);
+	void ParseVarlistentryGlossentry_(Node varlistentry, std::string& output);
+	void ParseInlineequation_(Node inlineequation, std::string& output);
+	void ParseInformalequation_(Node inlineequation, std::string& output);
+
+	void ParseAbstractMathNode_(Node node, std::string_view name, XmlName token, std::string& output);
+	void ParseAbstractMathNode_(Node node, std::string& output);
+	void ParseMathValue_(Node parent, std::string& output);
+	void ParseMmlmi_(Node mmlmi, std::string& output);
+	void ParseMmlmn_(Node mmlmn, std::string& output);
+	void ParseMmlmo_(Node mmlmo, std::string& output);
+	void ParseMmlmtext_(Node mmlmtext, std::string& output);
+	void ParseMmlmfenced_(Node mmlmfenced, std::string& output);
+	void ParseMmlmrow_(Node mmlmrow, std::string& output);
+	void ParseMmlmsup_(Node mmlmsup, std::string& output);
+	void ParseMmlmsub_(Node mmlmsub, std::string& output);
+	void ParseMmlmfrac_(Node mmlmfrac, std::string& output);
+	void ParseMmlmtable_(Node mmlmtable, std::string& output);
+	void ParseMmlmtr_(Node mmlmtr, std::string& output);
+	void ParseMmlmtd_(Node mmlmtd, std::string& output);
+	static void ParseMmlmspace_(Node mmlmspace, std::string& output);
+
+	void ParseLaTeX_(std::string_view type, std::string_view input, std::string& output);
+	std::string_view ParseInnerLaTeX_(std::string_view input);
 
 	void ParseParameters_(Node refsect1, impl_refsect_parameters& parameters);
 	void ParseVariablelist_(Node variablelist, impl_refsect_parameters& parameters);
@@ -189,15 +382,31 @@ private:
 	void ParseTerm_(Node term, impl_varlistentry& varlistentry);
 	void ParseDescription_(Node refsect1, impl_refsect_description& description);
 
-	void GenerateHeader_(std::ostream& output, const impl_funcprototype& prototype) const;
-	void GenerateComments_(std::ostream& output, const impl_funcprototype& prototype) const;
-	void GenerateText_(std::ostream& output, const impl_abstract_text& text) const;
+	void GenerateHeader_(std::ostream& output, const impl_funcprototype& prototype, const includes& options, RenderedComments& rendered) const;
+	void GenerateComments_(std::ostream& output, const impl_funcprototype& prototype, const includes& options, RenderedComments& rendered) const;
+
+	// Returns the rendering of a comment section, calling render to render it
+	// the first time.
+	template<typename F>
+	const std::string& Memoize_(std::optional<RenderedSection>& rendered, const F& render) const;
+	void GenerateText_(std::ostream& output, const impl_abstract_text& text, bool sharedDocs) const;
 	void GenerateText_(std::ostream& output, std::string_view text) const;
+	static std::string_view WrapText_(std::ostream& output, std::string_view text);
 
-	std::filesystem::path _dir;
+	const RefpageSource* _refpages;
 	std::string _name;
+	// the log is swapped for a buffer while a comment section is rendered
+	mutable std::ostream* _log;
+	std::ostream* _capture = nullptr;
+	std::vector<std::string> _includes;
+
+	// whether the equation that is being rendered contains a table
+	bool _mathTable = false;
+
+	// the arena of the model, declared before it so that it outlives it
+	std::unique_ptr<std::pmr::monotonic_buffer_resource> _arena;
 
-	std::vector<impl_copyright> _copyrights;
+	Vector<impl_copyright> _copyrights;
 	impl_refmeta _refmeta;
 	impl_refnamediv _refnamediv;
 	impl_refsynopsisdiv _refsynopsisdiv;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "RefpageCache.h"
+#include "Binary.h"
+#include "FileBuffer.h"
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <vector>
+
+constexpr static std::string_view cacheMagic = "GLWRIR";
+
+// Bump this whenever the binary form of a refpage changes.
+constexpr static std::uint64_t cacheVersion = 3;
+
+RefpageCache::RefpageCache(std::filesystem::path dir, RefpageSource& refpages) :
+		_dir(std::move(dir)),
+		_refpages(&refpages) {
+
+	std::filesystem::create_directories(_dir);
+}
+
+std::optional<Refpage> RefpageCache::Load(const std::string& name, std::uint64_t key, std::ostream& log) {
+	FileBuffer buffer = FileBuffer::Map(EntryPath_(name));
+	BinaryReader reader({ buffer.Data(), buffer.Size() });
+
+	if (reader.ReadRaw(cacheMagic.size()) != cacheMagic || reader.ReadNumber() != cacheVersion || reader.ReadNumber() != key) {
+		return std::nullopt;
+	}
+
+	auto includeCount = reader.ReadNumber();
+	for (std::uint64_t i = 0; i < includeCount && !reader.Failed(); i++) {
+		std::string_view include = reader.ReadString();
+		std::uint64_t hash = reader.ReadNumber();
+
+		if (reader.Failed() || _refpages->Hash(std::string(include)) != hash) {
+			return std::nullopt;
+		}
+	}
+
+	std::string_view diagnostics = reader.ReadString();
+	std::string_view model = reader.ReadString();
+
+	if (reader.Failed() || !reader.AtEnd()) {
+		return std::nullopt;
+	}
+
+	auto refpage = Refpage::Deserialize(*_refpages, name, model, log);
+	if (refpage) {
+		log << diagnostics;
+	}
+
+	return refpage;
+}
+
+void RefpageCache::Store(const Refpage& refpage, std::uint64_t key, std::string_view diagnostics) {
+	std::vector<std::string> includes = refpage.Includes();
+	std::sort(includes.begin(), includes.end());
+	includes.erase(std::unique(includes.begin(), includes.end()), includes.end());
+
+	BinaryWriter writer;
+	writer.WriteRaw(cacheMagic);
+	writer.WriteNumber(cacheVersion);
+	writer.WriteNumber(key);
+	writer.WriteNumber(includes.size());
+
+	for (const auto& include : includes) {
+		writer.WriteString(include);
+		writer.WriteNumber(_refpages->Hash(include));
+	}
+
+	writer.WriteString(diagnostics);
+	writer.WriteString(refpage.Serialize());
+
+	replaceFileIfChanged(EntryPath_(refpage.Name()), writer.Data());
+}
+
+std::filesystem::path RefpageCache::EntryPath_(const std::string& name) const {
+	return _dir / (name + ".bin");
+}
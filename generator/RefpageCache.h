@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_REFPAGECACHE_H
+#define GLWR_REFPAGECACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "Refpage.h"
+#include "RefpageSource.h"
+
+/*
+ * An on-disk cache of parsed refpages, one file per page. An entry is keyed by
+ * the hash of the page source, the generator and the options, and records the
+ * hashes of the included files and the diagnostics of parsing the page. A page
+ * whose source or includes changed is parsed again, but every other page is
+ * loaded from its binary form without touching the XML.
+ */
+class RefpageCache {
+
+public:
+	RefpageCache(std::filesystem::path dir, RefpageSource& refpages);
+
+	/*
+	 * Loads the refpage with the given name and key. The diagnostics of the
+	 * original parse are written to log again. Returns an empty optional if
+	 * there is no valid entry.
+	 */
+	std::optional<Refpage> Load(const std::string& name, std::uint64_t key, std::ostream& log);
+
+	/*
+	 * Stores a parsed refpage under key, with the diagnostics its parse wrote.
+	 */
+	void Store(const Refpage& refpage, std::uint64_t key, std::string_view diagnostics);
+
+private:
+	std::filesystem::path EntryPath_(const std::string& name) const;
+
+	std::filesystem::path _dir;
+	RefpageSource* _refpages;
+
+};
+
+#endif
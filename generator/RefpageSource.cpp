@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "RefpageSource.h"
+#include "Hash.h"
+
+#include <ctre.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+constexpr static std::size_t tarBlockSize = 512;
+
+static bool isPage(std::string_view filename) {
+	return ctre::match<"gl[A-Z]\\w*\\.xml">(filename);
+}
+
+// a NUL-terminated string in a fixed size field
+static std::string_view tarString(std::string_view field) {
+	return field.substr(0, field.find('\0'));
+}
+
+// an octal number, or a big-endian base-256 number if the high bit is set
+static std::optional<std::uint64_t> tarNumber(std::string_view field) {
+	std::uint64_t value = 0;
+
+	if (!field.empty() && (static_cast<unsigned char>(field[0]) & 0x80) != 0) {
+		value = static_cast<unsigned char>(field[0]) & 0x7f;
+
+		for (char c : field.substr(1)) {
+			value = (value << 8) | static_cast<unsigned char>(c);
+		}
+
+		return value;
+	}
+
+	bool digits = false;
+
+	for (char c : field) {
+		if (c >= '0' && c <= '7') {
+			value = (value << 3) | static_cast<std::uint64_t>(c - '0');
+			digits = true;
+		} else if (c == '\0' || c == ' ') {
+			if (digits) {
+				break;
+			}
+		} else {
+			return std::nullopt;
+		}
+	}
+
+	return value;
+}
+
+// the path record of a pax extended header, if it has one
+static std::string paxPath(std::string_view records) {
+	std::string path;
+
+	// every record is "<length> <key>=<value>\n", with a decimal length
+	while (!records.empty()) {
+		std::size_t length = 0;
+		std::size_t digits = 0;
+
+		while (digits < records.size() && records[digits] >= '0' && records[digits] <= '9') {
+			length = length * 10 + static_cast<std::size_t>(records[digits] - '0');
+			digits++;
+		}
+
+		if (digits == 0 || digits >= records.size() || records[digits] != ' ' || length < digits + 2 || length > records.size()) {
+			break;
+		}
+
+		std::string_view record = records.substr(digits + 1, length - digits - 2);
+		if (record.starts_with("path=")) {
+			path = record.substr(5);
+		}
+
+		records.remove_prefix(length);
+	}
+
+	return path;
+}
+
+RefpageSource::RefpageSource(const std::filesystem::path& path) {
+	if (std::filesystem::is_directory(path)) {
+		_dir = std::filesystem::is_directory(path / "gl4") ? path / "gl4" : path;
+	} else if (std::filesystem::is_regular_file(path)) {
+		_archive = path;
+		IndexArchive_();
+	} else {
+		throw std::runtime_error("Cannot read refpages from " + path.string());
+	}
+}
+
+std::vector<std::string> RefpageSource::Pages() const {
+	std::vector<std::string> pages;
+
+	if (_archive) {
+		for (const auto& [name, entry] : _entries) {
+			std::filesystem::path path(name);
+
+			if (path.parent_path().generic_string() == _root && isPage(path.filename().string())) {
+				pages.push_back(path.filename().string());
+			}
+		}
+	} else {
+		for (const auto& p : std::filesystem::directory_iterator(_dir)) {
+			std::string filename = p.path().filename().string();
+			if (isPage(filename)) {
+				pages.push_back(std::move(filename));
+			}
+		}
+	}
+
+	// on some systems the directory_iterator doesn't sort by name, so do it
+	// manually here.
+	std::sort(pages.begin(), pages.end());
+
+	return pages;
+}
+
+FileBuffer RefpageSource::Map(const std::string& name) const {
+	if (!_archive) {
+		return _read ? FileBuffer::Read(_dir / name) : FileBuffer::Map(_dir / name);
+	}
+
+	auto iter = _entries.find(ArchiveName_(name));
+	if (iter == _entries.end()) {
+		return FileBuffer();
+	}
+
+	return FileBuffer::Map(*_archive, iter->second.offset, iter->second.size);
+}
+
+std::uint64_t RefpageSource::Hash(const std::string& name) {
+	std::string key = std::filesystem::path(name).lexically_normal().generic_string();
+
+	{
+		std::lock_guard lock(_mutex);
+		if (auto iter = _hashes.find(key); iter != _hashes.end()) {
+			return iter->second;
+		}
+	}
+
+	FileBuffer buffer = Map(key);
+	std::uint64_t hash = fnv1a({ buffer.Data(), buffer.Size() });
+
+	std::lock_guard lock(_mutex);
+	_hashes.emplace(std::move(key), hash);
+	return hash;
+}
+
+void RefpageSource::Forget(const std::string& name) {
+	std::lock_guard lock(_mutex);
+	_hashes.erase(std::filesystem::path(name).lexically_normal().generic_string());
+}
+
+std::filesystem::path RefpageSource::Dependency(const std::string& name) const {
+	return _archive ? *_archive : _dir / name;
+}
+
+void RefpageSource::IndexArchive_() {
+	FileBuffer archive = FileBuffer::Map(*_archive);
+	std::string_view data(archive.Data(), archive.Size());
+
+	// the name of the next entry, from a GNU long name or pax header
+	std::string longName;
+	std::uint64_t offset = 0;
+
+	while (offset + tarBlockSize <= data.size()) {
+		std::string_view header = data.substr(offset, tarBlockSize);
+
+		// the archive ends with empty blocks
+		if (header[0] == '\0') {
+			break;
+		}
+
+		auto size = tarNumber(header.substr(124, 12));
+		std::uint64_t contents = offset + tarBlockSize;
+
+		if (!size || *size > data.size() - contents) {
+			throw std::runtime_error("Corrupt tar archive: " + _archive->string());
+		}
+
+		std::string_view body = data.substr(contents, *size);
+		char type = header[156];
+
+		if (type == 'L') {
+			longName = tarString(body);
+		} else if (type == 'x') {
+			longName = paxPath(body);
+		} else if (type != 'g') {
+			if (type == '0' || type == '\0') {
+				std::string name = longName;
+
+				if (name.empty()) {
+					name = tarString(header.substr(0, 100));
+
+					// ustar splits long names into a prefix and a name
+					std::string_view prefix = tarString(header.substr(345, 155));
+					if (header.substr(257, 5) == "ustar" && !prefix.empty()) {
+						name = std::string(prefix) + "/" + name;
+					}
+				}
+
+				std::string key = std::filesystem::path(name).lexically_normal().generic_string();
+				_entries[key] = { contents, static_cast<std::size_t>(*size) };
+			}
+
+			longName.clear();
+		}
+
+		offset = contents + (*size + tarBlockSize - 1) / tarBlockSize * tarBlockSize;
+	}
+
+	// The gl4 directory may be at the root of the archive or in a directory,
+	// e.g. the OpenGL-Refpages-<commit> directory of a GitHub archive. An
+	// archive of the gl4 directory's contents has the pages at its root.
+	std::optional<std::string> root;
+	bool pagesAtRoot = false;
+
+	for (const auto& [name, entry] : _entries) {
+		std::filesystem::path path(name);
+		std::filesystem::path parent = path.parent_path();
+
+		if (!isPage(path.filename().string())) {
+			continue;
+		}
+
+		if (parent.filename() == "gl4") {
+			std::string candidate = parent.generic_string();
+
+			if (!root || candidate.size() < root->size()) {
+				root = std::move(candidate);
+			}
+		} else if (parent.empty()) {
+			pagesAtRoot = true;
+		}
+	}
+
+	if (!root && pagesAtRoot) {
+		root.emplace();
+	}
+
+	if (!root) {
+		throw std::runtime_error("No gl4 refpages in " + _archive->string());
+	}
+
+	_root = std::move(*root);
+}
+
+std::string RefpageSource::ArchiveName_(const std::string& name) const {
+	return (std::filesystem::path(_root) / name).lexically_normal().generic_string();
+}
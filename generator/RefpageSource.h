@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_REFPAGESOURCE_H
+#define GLWR_REFPAGESOURCE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileBuffer.h"
+
+/*
+ * Where the gl4 refpages and the fragments they include are read from: a
+ * directory, or an uncompressed tar archive. The entries of an archive are
+ * mapped into memory straight from the archive, without extracting them. All
+ * files are named relative to the gl4 directory.
+ */
+class RefpageSource {
+
+public:
+	/*
+	 * Opens an OpenGL-Refpages checkout, its gl4 directory, or a tar archive of
+	 * either. Throws a std::runtime_error if the refpages cannot be read.
+	 */
+	explicit RefpageSource(const std::filesystem::path& path);
+
+	/*
+	 * The file names of the function refpages, sorted by name.
+	 */
+	std::vector<std::string> Pages() const;
+
+	/*
+	 * Maps a file. Returns an empty buffer if it doesn't exist.
+	 */
+	FileBuffer Map(const std::string& name) const;
+
+	/*
+	 * Reads the files of a directory into memory from now on, instead of
+	 * mapping them. A mapped file that an editor truncates while it is parsed
+	 * kills the process with SIGBUS.
+	 */
+	void ReadIntoMemory() { _read = true; }
+
+	/*
+	 * The hash of the contents of a file. Every file is hashed at most once.
+	 * Can be used from multiple threads.
+	 */
+	std::uint64_t Hash(const std::string& name);
+
+	/*
+	 * Forgets the hash of a file that changed, so that it is hashed again.
+	 */
+	void Forget(const std::string& name);
+
+	/*
+	 * The file on disk that a build depends on for a file: the file itself, or
+	 * the archive it is in.
+	 */
+	std::filesystem::path Dependency(const std::string& name) const;
+
+	/*
+	 * The gl4 directory the files are read from, or an empty path if they are
+	 * read from an archive.
+	 */
+	const std::filesystem::path& Directory() const { return _dir; }
+
+private:
+	struct Entry {
+		std::uint64_t offset;
+		std::size_t size;
+	};
+
+	void IndexArchive_();
+	std::string ArchiveName_(const std::string& name) const;
+
+	// a directory...
+	std::filesystem::path _dir;
+	bool _read = false;
+
+	// ...or an archive, with the path of the gl4 directory in it
+	std::optional<std::filesystem::path> _archive;
+	std::string _root;
+	std::unordered_map<std::string, Entry> _entries;
+
+	std::mutex _mutex;
+	std::unordered_map<std::string, std::uint64_t> _hashes;
+
+};
+
+#endif
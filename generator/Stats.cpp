@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "Stats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+constexpr static std::array<const char*, phaseCount> phaseNames = {
+		"read",
+		"xml_load",
+		"parse",
+		"parameters",
+		"description",
+		"examples",
+		"notes",
+		"errors",
+		"associated_gets",
+		"versions",
+		"see_also",
+		"copyright",
+		"include",
+		"latex",
+		"mathml",
+		"cache",
+		"generate",
+		"wrap",
+		"write",
+};
+
+constexpr static std::array<const char*, sectionCount> sectionNames = {
+		"code",
+		"brief",
+		"version",
+		"description",
+		"examples",
+		"notes",
+		"parameters",
+		"errors",
+		"associated_gets",
+		"see_also",
+		"copyright",
+};
+
+void PageStats::Add(const PageStats& other) {
+	inputBytes += other.inputBytes;
+	outputBytes += other.outputBytes;
+	allocations += other.allocations;
+
+	for (std::size_t i = 0; i < phaseCount; i++) {
+		nanoseconds[i] += other.nanoseconds[i];
+		calls[i] += other.calls[i];
+	}
+
+	for (std::size_t i = 0; i < sectionCount; i++) {
+		bytes[i] += other.bytes[i];
+	}
+}
+
+std::uint64_t PageStats::TotalNanoseconds() const {
+	return std::accumulate(nanoseconds.begin(), nanoseconds.end(), std::uint64_t(0));
+}
+
+std::uint64_t PageStats::DocumentationBytes() const {
+	return std::accumulate(bytes.begin() + 1, bytes.end(), std::uint64_t(0));
+}
+
+static PageStats totalStats(const std::vector<PageStats>& pages) {
+	PageStats total;
+
+	for (const auto& page : pages) {
+		total.Add(page);
+	}
+
+	return total;
+}
+
+static void writeJsonString(std::ostream& output, std::string_view str) {
+	output << '"';
+
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			output << '\\';
+		}
+
+		output << c;
+	}
+
+	output << '"';
+}
+
+static void writeJsonStats(std::ostream& output, const PageStats& stats, const char* indent) {
+	output << indent << "\"input_bytes\": " << stats.inputBytes << ",\n";
+	output << indent << "\"output_bytes\": " << stats.outputBytes << ",\n";
+	output << indent << "\"allocations\": " << stats.allocations << ",\n";
+	output << indent << "\"ns\": " << stats.TotalNanoseconds() << ",\n";
+
+	output << indent << "\"phases\": {";
+	for (std::size_t i = 0; i < phaseCount; i++) {
+		output << (i == 0 ? "\n" : ",\n") << indent << "\t\"" << phaseNames[i] << "\": { \"ns\": " << stats.nanoseconds[i] << ", \"calls\": " << stats.calls[i] << " }";
+	}
+	output << "\n" << indent << "},\n";
+
+	output << indent << "\"section_bytes\": {";
+	for (std::size_t i = 0; i < sectionCount; i++) {
+		output << (i == 0 ? "\n" : ",\n") << indent << "\t\"" << sectionNames[i] << "\": " << stats.bytes[i];
+	}
+	output << "\n" << indent << "}\n";
+}
+
+void writeStatsJson(std::ostream& output, const std::vector<PageStats>& pages, std::uint64_t wallNanoseconds, unsigned jobs) {
+	std::size_t generated = std::count_if(pages.begin(), pages.end(), [](const PageStats& page) { return page.generated; });
+
+	output << "{\n";
+	output << "\t\"wall_ns\": " << wallNanoseconds << ",\n";
+	output << "\t\"jobs\": " << jobs << ",\n";
+	output << "\t\"pages\": " << pages.size() << ",\n";
+	output << "\t\"generated\": " << generated << ",\n";
+
+	output << "\t\"total\": {\n";
+	writeJsonStats(output, totalStats(pages), "\t\t");
+	output << "\t},\n";
+
+	output << "\t\"per_page\": [";
+	for (std::size_t i = 0; i < pages.size(); i++) {
+		output << (i == 0 ? "\n" : ",\n") << "\t\t{\n";
+		output << "\t\t\t\"name\": ";
+		writeJsonString(output, pages[i].name);
+		output << ",\n";
+		output << "\t\t\t\"generated\": " << (pages[i].generated ? "true" : "false") << ",\n";
+		writeJsonStats(output, pages[i], "\t\t\t");
+		output << "\t\t}";
+	}
+	output << "\n\t]\n";
+
+	output << "}\n";
+}
+
+void writeStatsTable(std::ostream& output, const std::vector<PageStats>& pages, std::uint64_t wallNanoseconds) {
+	constexpr std::size_t slowestCount = 5;
+
+	PageStats total = totalStats(pages);
+	auto totalNanoseconds = std::max<std::uint64_t>(total.TotalNanoseconds(), 1);
+	auto totalBytes = std::max<std::uint64_t>(total.outputBytes, 1);
+
+	auto flags = output.flags();
+	output << std::fixed << std::setprecision(3);
+
+	output << std::left << std::setw(18) << "Phase" << std::right << std::setw(12) << "Time (ms)" << std::setw(8) << "%" << std::setw(10) << "Calls" << '\n';
+	for (std::size_t i = 0; i < phaseCount; i++) {
+		output << std::left << std::setw(18) << phaseNames[i] << std::right
+				<< std::setw(12) << total.nanoseconds[i] / 1e6
+				<< std::setprecision(1) << std::setw(7) << 100.0 * total.nanoseconds[i] / totalNanoseconds << '%'
+				<< std::setprecision(3) << std::setw(10) << total.calls[i] << '\n';
+	}
+	output << std::left << std::setw(18) << "total (threads)" << std::right << std::setw(12) << total.TotalNanoseconds() / 1e6 << '\n';
+	output << std::left << std::setw(18) << "total (wall)" << std::right << std::setw(12) << wallNanoseconds / 1e6 << '\n';
+
+	output << '\n';
+	output << std::left << std::setw(18) << "Section" << std::right << std::setw(12) << "Bytes" << std::setw(8) << "%" << '\n';
+	for (std::size_t i = 0; i < sectionCount; i++) {
+		output << std::left << std::setw(18) << sectionNames[i] << std::right
+				<< std::setw(12) << total.bytes[i]
+				<< std::setprecision(1) << std::setw(7) << 100.0 * total.bytes[i] / totalBytes << '%' << std::setprecision(3) << '\n';
+	}
+	output << std::left << std::setw(18) << "input" << std::right << std::setw(12) << total.inputBytes << '\n';
+	output << std::left << std::setw(18) << "output" << std::right << std::setw(12) << total.outputBytes << '\n';
+	output << std::left << std::setw(18) << "allocations" << std::right << std::setw(12) << total.allocations << '\n';
+
+	// the pages that took the longest
+	std::vector<const PageStats*> slowest;
+	for (const auto& page : pages) {
+		slowest.push_back(&page);
+	}
+
+	std::size_t count = std::min(slowestCount, slowest.size());
+	std::partial_sort(slowest.begin(), slowest.begin() + count, slowest.end(), [](const PageStats* a, const PageStats* b) {
+		return a->TotalNanoseconds() > b->TotalNanoseconds();
+	});
+
+	output << '\n';
+	output << std::left << std::setw(30) << "Slowest pages" << std::right << std::setw(12) << "Time (ms)" << std::setw(14) << "Allocations" << '\n';
+	for (std::size_t i = 0; i < count; i++) {
+		output << std::left << std::setw(30) << slowest[i]->name << std::right
+				<< std::setw(12) << slowest[i]->TotalNanoseconds() / 1e6
+				<< std::setw(14) << slowest[i]->allocations << '\n';
+	}
+
+	output.flags(flags);
+}
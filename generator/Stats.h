@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_STATS_H
+#define GLWR_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * The phases the time of generating a page is divided in.
+ */
+enum class Phase {
+	Read,
+	XmlLoad,
+	Parse,
+	Parameters,
+	Description,
+	Examples,
+	Notes,
+	Errors,
+	AssociatedGets,
+	Versions,
+	SeeAlso,
+	Copyright,
+	Include,
+	LaTeX,
+	MathML,
+	Cache,
+	Generate,
+	Wrap,
+	Write,
+	Count
+};
+
+/*
+ * The parts of a generated header that bytes are counted for. Code is
+ * everything that is not a documentation section.
+ */
+enum class Section {
+	Code,
+	Brief,
+	Version,
+	Description,
+	Examples,
+	Notes,
+	Parameters,
+	Errors,
+	AssociatedGets,
+	SeeAlso,
+	Copyright,
+	Count
+};
+
+constexpr std::size_t phaseCount = static_cast<std::size_t>(Phase::Count);
+constexpr std::size_t sectionCount = static_cast<std::size_t>(Section::Count);
+
+/*
+ * The timings and counters of one page, or the total of several.
+ */
+struct PageStats {
+	using Clock = std::chrono::steady_clock;
+
+	std::string name;
+	bool generated = false;
+
+	std::uint64_t inputBytes = 0;
+	std::uint64_t outputBytes = 0;
+
+	// the heap allocations made while the page was generated, as counted by
+	// the operator new of the generator
+	std::uint64_t allocations = 0;
+
+	std::array<std::uint64_t, phaseCount> nanoseconds{};
+	std::array<std::uint64_t, phaseCount> calls{};
+	std::array<std::uint64_t, sectionCount> bytes{};
+
+	// the phase that is currently timed, and since when
+	std::optional<Phase> active;
+	Clock::time_point since;
+
+	void Add(const PageStats& other);
+
+	std::uint64_t TotalNanoseconds() const;
+	std::uint64_t DocumentationBytes() const;
+};
+
+/*
+ * The stats of the page the current thread is generating, or nullptr if no
+ * stats are recorded.
+ */
+inline constinit thread_local PageStats* pageStats = nullptr;
+
+/*
+ * Records stats into a page for as long as it lives.
+ */
+class StatsScope {
+
+public:
+	explicit StatsScope(PageStats* stats) :
+			_previous(pageStats) {
+
+		pageStats = stats;
+	}
+
+	~StatsScope() {
+		pageStats = _previous;
+	}
+
+	StatsScope(const StatsScope&) = delete;
+	StatsScope& operator=(const StatsScope&) = delete;
+
+private:
+	PageStats* _previous;
+
+};
+
+/*
+ * Times a phase for as long as it lives. Phases nest: the time spent in an
+ * inner phase is not counted for the outer one, so the phases of a page add up
+ * to its total time.
+ */
+class PhaseTimer {
+
+public:
+	explicit PhaseTimer(Phase phase) :
+			_stats(pageStats) {
+
+		if (!_stats) {
+			return;
+		}
+
+		auto now = PageStats::Clock::now();
+		Stop_(now);
+
+		_previous = _stats->active;
+		_stats->active = phase;
+		_stats->since = now;
+		_stats->calls[static_cast<std::size_t>(phase)]++;
+	}
+
+	~PhaseTimer() {
+		if (!_stats) {
+			return;
+		}
+
+		auto now = PageStats::Clock::now();
+		Stop_(now);
+
+		_stats->active = _previous;
+		_stats->since = now;
+	}
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+	void Stop_(PageStats::Clock::time_point now) {
+		if (_stats->active) {
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _stats->since);
+			_stats->nanoseconds[static_cast<std::size_t>(*_stats->active)] += elapsed.count();
+		}
+	}
+
+	PageStats* _stats;
+	std::optional<Phase> _previous;
+
+};
+
+/*
+ * Counts the bytes written to output for a section for as long as it lives.
+ */
+class SectionCounter {
+
+public:
+	SectionCounter(std::ostream& output, Section section) :
+			_stats(pageStats),
+			_output(output),
+			_section(section) {
+
+		if (_stats) {
+			_start = output.tellp();
+		}
+	}
+
+	~SectionCounter() {
+		if (_stats && _start >= 0) {
+			auto end = _output.tellp();
+
+			if (end >= _start) {
+				_stats->bytes[static_cast<std::size_t>(_section)] += static_cast<std::uint64_t>(end - _start);
+			}
+		}
+	}
+
+	SectionCounter(const SectionCounter&) = delete;
+	SectionCounter& operator=(const SectionCounter&) = delete;
+
+private:
+	PageStats* _stats;
+	std::ostream& _output;
+	Section _section;
+	std::streamoff _start = -1;
+
+};
+
+/*
+ * Writes the stats of all pages, and their total, as JSON.
+ */
+void writeStatsJson(std::ostream& output, const std::vector<PageStats>& pages, std::uint64_t wallNanoseconds, unsigned jobs);
+
+/*
+ * Writes a summary of the stats as a table.
+ */
+void writeStatsTable(std::ostream& output, const std::vector<PageStats>& pages, std::uint64_t wallNanoseconds);
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "TextScanner.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GLWR_SCAN_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * A classifier fills in the class masks of a chunk of 64 characters.
+ */
+using Classifier = void (*)(const char* data, TextScanner::Chunk& chunk);
+
+// the index of the mask of a class in a chunk
+constexpr unsigned maskIndex(CharClass charClass) {
+	return static_cast<unsigned>(std::countr_zero(static_cast<unsigned>(charClass)));
+}
+
+static void classifyScalar(const char* data, TextScanner::Chunk& chunk) {
+	chunk.fill(0);
+
+	for (unsigned i = 0; i < 64; i++) {
+		chunk[maskIndex(static_cast<CharClass>(charClass(data[i])))] |= std::uint64_t(1) << i;
+	}
+}
+
+#ifdef GLWR_SCAN_X86
+
+/*
+ * The vector classifiers compare a block of characters against each class at
+ * once. A character is in a range of characters if it minus the start of the
+ * range, unsigned, does not exceed the length of the range. Lowercasing makes
+ * one range cover both cases of the letters.
+ */
+
+__attribute__((target("sse2")))
+static void classifySse2(const char* data, TextScanner::Chunk& chunk) {
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i less = _mm_set1_epi8('<');
+	const __m128i quote = _mm_set1_epi8('\'');
+	const __m128i dash = _mm_set1_epi8('-');
+	const __m128i underscore = _mm_set1_epi8('_');
+	const __m128i lowercase = _mm_set1_epi8(0x20);
+	const __m128i a = _mm_set1_epi8('a');
+	const __m128i letters = _mm_set1_epi8(25);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i digits = _mm_set1_epi8(9);
+
+	chunk.fill(0);
+
+	for (unsigned i = 0; i < 64; i += 16) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i letter = _mm_sub_epi8(_mm_or_si128(block, lowercase), a);
+		__m128i digit = _mm_sub_epi8(block, zero);
+
+		std::uint64_t isSpace = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, space)));
+		std::uint64_t isNewline = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+		std::uint64_t isLess = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, less)));
+		std::uint64_t isWordPunct = static_cast<std::uint32_t>(_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, dash))));
+		std::uint64_t isWord = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(
+				_mm_cmpeq_epi8(_mm_min_epu8(letter, letters), letter),
+				_mm_cmpeq_epi8(_mm_min_epu8(digit, digits), digit)),
+				_mm_cmpeq_epi8(block, underscore))));
+		std::uint64_t isOther = ~(isSpace | isNewline | isLess | isWordPunct | isWord) & 0xffff;
+
+		chunk[maskIndex(CharOther)] |= isOther << i;
+		chunk[maskIndex(CharSpace)] |= isSpace << i;
+		chunk[maskIndex(CharNewline)] |= isNewline << i;
+		chunk[maskIndex(CharLess)] |= isLess << i;
+		chunk[maskIndex(CharWord)] |= isWord << i;
+		chunk[maskIndex(CharWordPunct)] |= isWordPunct << i;
+	}
+}
+
+__attribute__((target("avx2")))
+static void classifyAvx2(const char* data, TextScanner::Chunk& chunk) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i less = _mm256_set1_epi8('<');
+	const __m256i quote = _mm256_set1_epi8('\'');
+	const __m256i dash = _mm256_set1_epi8('-');
+	const __m256i underscore = _mm256_set1_epi8('_');
+	const __m256i lowercase = _mm256_set1_epi8(0x20);
+	const __m256i a = _mm256_set1_epi8('a');
+	const __m256i letters = _mm256_set1_epi8(25);
+	const __m256i zero = _mm256_set1_epi8('0');
+	const __m256i digits = _mm256_set1_epi8(9);
+
+	chunk.fill(0);
+
+	for (unsigned i = 0; i < 64; i += 32) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i letter = _mm256_sub_epi8(_mm256_or_si256(block, lowercase), a);
+		__m256i digit = _mm256_sub_epi8(block, zero);
+
+		std::uint64_t isSpace = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, space)));
+		std::uint64_t isNewline = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+		std::uint64_t isLess = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, less)));
+		std::uint64_t isWordPunct = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, dash))));
+		std::uint64_t isWord = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(
+				_mm256_cmpeq_epi8(_mm256_min_epu8(letter, letters), letter),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(digit, digits), digit)),
+				_mm256_cmpeq_epi8(block, underscore))));
+		std::uint64_t isOther = ~(isSpace | isNewline | isLess | isWordPunct | isWord) & 0xffffffff;
+
+		chunk[maskIndex(CharOther)] |= isOther << i;
+		chunk[maskIndex(CharSpace)] |= isSpace << i;
+		chunk[maskIndex(CharNewline)] |= isNewline << i;
+		chunk[maskIndex(CharLess)] |= isLess << i;
+		chunk[maskIndex(CharWord)] |= isWord << i;
+		chunk[maskIndex(CharWordPunct)] |= isWordPunct << i;
+	}
+}
+
+#endif
+
+ScanLevel maxScanLevel() {
+#ifdef GLWR_SCAN_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return ScanLevel::Avx2;
+	}
+
+	if (__builtin_cpu_supports("sse2")) {
+		return ScanLevel::Sse2;
+	}
+#endif
+
+	return ScanLevel::Scalar;
+}
+
+static Classifier classifierFor(ScanLevel level) {
+	switch (level) {
+#ifdef GLWR_SCAN_X86
+		case ScanLevel::Avx2:
+			return classifyAvx2;
+		case ScanLevel::Sse2:
+			return classifySse2;
+#endif
+		default:
+			return classifyScalar;
+	}
+}
+
+static Classifier classifier = classifierFor(maxScanLevel());
+
+void setScanLevel(ScanLevel level) {
+	classifier = classifierFor(std::min(level, maxScanLevel()));
+}
+
+void TextScanner::Scan(std::string_view text) {
+	_text = text;
+	_chunks.resize((text.size() + 63) / 64);
+
+	std::size_t full = text.size() / 64;
+	for (std::size_t i = 0; i < full; i++) {
+		classifier(text.data() + i * 64, _chunks[i]);
+	}
+
+	// the last chunk is padded, and the padding is in no class at all
+	if (std::size_t rest = text.size() % 64; rest != 0) {
+		char padded[64] = {};
+		std::memcpy(padded, text.data() + full * 64, rest);
+		classifier(padded, _chunks[full]);
+
+		for (std::uint64_t& mask : _chunks[full]) {
+			mask &= (std::uint64_t(1) << rest) - 1;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_TEXTSCANNER_H
+#define GLWR_TEXTSCANNER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ * The classes the word wrapper divides characters in. Every character is in
+ * exactly one of them.
+ */
+enum CharClass : unsigned {
+	CharOther = 1,
+	CharSpace = 2,
+	CharNewline = 4,
+	CharLess = 8,
+	CharWord = 16,       // [A-Za-z0-9_]
+	CharWordPunct = 32   // ' and -
+};
+
+constexpr unsigned charClassCount = 6;
+
+constexpr unsigned charClass(char c) {
+	switch (c) {
+		case ' ':
+			return CharSpace;
+		case '\n':
+			return CharNewline;
+		case '<':
+			return CharLess;
+		case '\'':
+		case '-':
+			return CharWordPunct;
+		case '_':
+			return CharWord;
+		default:
+			break;
+	}
+
+	if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+		return CharWord;
+	}
+
+	return CharOther;
+}
+
+/*
+ * The instruction sets the text scanner can classify with. By default, it uses
+ * the best one the CPU supports; the benchmarks select them one by one.
+ */
+enum class ScanLevel {
+	Scalar,
+	Sse2,
+	Avx2
+};
+
+ScanLevel maxScanLevel();
+void setScanLevel(ScanLevel level);
+
+/*
+ * Classifies all characters of a text up front, a vector at a time, into a
+ * bit mask per class. Finding the end of a run of characters is then a bit
+ * scan. A scanner can be reused for multiple texts, so its masks are only
+ * allocated once.
+ */
+class TextScanner {
+
+public:
+	using Chunk = std::array<std::uint64_t, charClassCount>;
+
+	/*
+	 * Classifies text, which must outlive the scans of it.
+	 */
+	void Scan(std::string_view text);
+
+	/*
+	 * Returns the end of the run of characters starting at pos whose class is
+	 * one of classes.
+	 */
+	std::size_t Run(std::size_t pos, unsigned classes) const {
+		while (pos < _text.size()) {
+			const Chunk& chunk = _chunks[pos / 64];
+			unsigned bit = pos % 64;
+
+			std::uint64_t run = 0;
+			for (unsigned i = 0; i < charClassCount; i++) {
+				if (classes & (1u << i)) {
+					run |= chunk[i];
+				}
+			}
+
+			// the bits shifted in are zero, so the scan stops at the end of the
+			// chunk at the latest
+			unsigned length = std::countr_zero(~(run >> bit));
+			pos += length;
+
+			if (bit + length < 64) {
+				break;
+			}
+		}
+
+		return std::min(pos, _text.size());
+	}
+
+private:
+	std::string_view _text;
+	std::vector<Chunk> _chunks;
+
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "TextTokens.h"
+#include "Stats.h"
+#include "TextScanner.h"
+
+// Returns the end of the inline tag, preformatted block or other tag at begin,
+// or begin if there is none, and sets kind to what it is.
+static std::size_t findTagEnd(std::string_view text, std::size_t begin, TokenKind& kind) {
+	std::string_view tag = text.substr(begin);
+
+	// inline tags around at most 64 characters without spaces
+	for (std::string_view name : { "code", "sub", "sup", "i", "b" }) {
+		if (tag.substr(1, name.size()) != name || tag.substr(name.size() + 1, 1) != ">") {
+			continue;
+		}
+
+		std::size_t contentsBegin = name.size() + 2;
+		std::size_t contentsEnd = std::min(tag.find_first_of(" <", contentsBegin), tag.size());
+		std::string_view close = tag.substr(contentsEnd);
+
+		if (contentsEnd - contentsBegin <= 64 && close.starts_with("</") && close.substr(2, name.size()) == name
+				&& close.substr(name.size() + 2, 1) == ">") {
+			kind = TokenKind::InlineTag;
+			return begin + contentsEnd + name.size() + 3;
+		}
+
+		break;
+	}
+
+	if (tag.starts_with("<pre>")) {
+		if (std::size_t end = tag.find("</pre>", 5); end != std::string_view::npos) {
+			kind = TokenKind::Preformatted;
+			return begin + end + 6;
+		}
+	}
+
+	if (std::size_t end = tag.find('>', 1); end != std::string_view::npos) {
+		kind = TokenKind::Markup;
+		return begin + end + 1;
+	}
+
+	return begin;
+}
+
+// Returns the end of the token at begin: punctuation, then a word or a tag,
+// then more punctuation. Sets kind to the kind of the word or tag.
+static std::size_t findTokenEnd(const TextScanner& scanner, std::string_view text, std::size_t begin, TokenKind& kind) {
+	std::size_t pos = scanner.Run(begin, CharOther | CharNewline | CharWordPunct);
+
+	if (pos < text.size() && text[pos] == '<') {
+		pos = findTagEnd(text, pos, kind);
+	} else {
+		kind = TokenKind::Word;
+		pos = scanner.Run(pos, CharWord | CharWordPunct);
+	}
+
+	return scanner.Run(pos, CharOther | CharWordPunct);
+}
+
+static void addToken(TextTokens& tokens, std::size_t begin, std::size_t end, TokenKind kind) {
+	tokens.push_back({ static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end - begin), kind });
+}
+
+void tokenizeText(std::string_view text, TextTokens& tokens) {
+	PhaseTimer timer(Phase::Wrap);
+
+	// classify the characters of the text in bulk
+	thread_local TextScanner scanner;
+	scanner.Scan(text);
+
+	std::size_t pos = 0;
+
+	while (pos < text.size()) {
+		if (text[pos] == '\n') {
+			addToken(tokens, pos, pos + 1, TokenKind::Break);
+			pos++;
+			continue;
+		}
+
+		// the spaces before the token
+		std::size_t tokenBegin = scanner.Run(pos, CharSpace);
+
+		if (tokenBegin != pos) {
+			addToken(tokens, pos, tokenBegin, TokenKind::Space);
+		}
+
+		TokenKind kind = TokenKind::Word;
+		std::size_t tokenEnd = findTokenEnd(scanner, text, tokenBegin, kind);
+
+		if (tokenEnd == pos) {
+			addToken(tokens, pos, text.size(), TokenKind::Unparsed);
+			return;
+		}
+
+		if (tokenEnd != tokenBegin) {
+			addToken(tokens, tokenBegin, tokenEnd, kind);
+		}
+
+		pos = tokenEnd;
+	}
+}
+
+std::string_view wrapTokens(std::ostream& output, std::string_view text, std::span<const TextToken> tokens) {
+	PhaseTimer timer(Phase::Wrap);
+
+	unsigned lineWidth = 0;
+	bool space = false;
+
+	for (const TextToken& token : tokens) {
+		switch (token.kind) {
+			case TokenKind::Break:
+				if (lineWidth == 0) {
+					output.write("/// \n", 5);
+				} else {
+					output.put('\n');
+					lineWidth = 0;
+				}
+
+				space = false;
+				break;
+
+			case TokenKind::Space:
+				space = true;
+				break;
+
+			case TokenKind::Unparsed:
+				return token.In(text);
+
+			default:
+				if (lineWidth == 0) {
+					output.write("/// ", 4);
+					space = true;
+				} else if (lineWidth + token.length + space > 77) {
+					output.write("\n/// ", 5);
+					lineWidth = 0;
+					space = true;
+				} else if (space) {
+					output.put(' ');
+				}
+
+				output.write(text.data() + token.begin, token.length);
+				lineWidth += token.length + space;
+				space = false;
+				break;
+		}
+	}
+
+	// end the final line
+	if (lineWidth > 0) {
+		output.put('\n');
+	}
+
+	return {};
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_TEXTTOKENS_H
+#define GLWR_TEXTTOKENS_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/*
+ * The kinds of tokens rendered documentation text is divided in. A word,
+ * inline tag, preformatted line or markup tag is kept on one line as a whole,
+ * together with the punctuation around it.
+ */
+enum class TokenKind : std::uint8_t {
+	Word,
+	Space,
+	InlineTag,    // <code>, <sub>, <sup>, <i> or <b> around a short word
+	Preformatted, // a <pre> line of a program listing
+	Markup,       // any other tag, like the tags of tables and lists
+	Break,        // a line break
+	Unparsed      // the rest of a text that could not be tokenized
+};
+
+/*
+ * A token of a text, by its position in it.
+ */
+struct TextToken {
+	std::uint32_t begin;
+	std::uint32_t length;
+	TokenKind kind;
+
+	std::string_view In(std::string_view text) const {
+		return text.substr(begin, length);
+	}
+};
+
+using TextTokens = std::pmr::vector<TextToken>;
+
+/*
+ * Divides text in tokens, and appends them to tokens. If a part of the text
+ * cannot be tokenized, it ends with an Unparsed token for the rest of it.
+ */
+void tokenizeText(std::string_view text, TextTokens& tokens);
+
+/*
+ * Writes the tokens of text as comment lines, wrapped at 77 characters after
+ * the comment marker. Returns the text of the Unparsed token if there is one,
+ * after writing the tokens before it, or an empty string otherwise.
+ */
+std::string_view wrapTokens(std::ostream& output, std::string_view text, std::span<const TextToken> tokens);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		_workers.push_back(std::make_unique<Worker>());
+	}
+
+	for (std::size_t i = 0; i < _workers.size(); i++) {
+		_workers[i]->thread = std::thread(&ThreadPool::WorkerLoop_, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(_mutex);
+		_stop = true;
+	}
+
+	_workAvailable.notify_all();
+
+	for (auto& worker : _workers) {
+		worker->thread.join();
+	}
+}
+
+void ThreadPool::Run(std::size_t count, Task task) {
+	Wait();
+
+	{
+		std::lock_guard lock(_mutex);
+		_task = std::move(task);
+		_pending = count;
+		_generation++;
+
+		for (std::size_t i = 0; i < count; i++) {
+			Worker& worker = *_workers[i % _workers.size()];
+			std::lock_guard workerLock(worker.mutex);
+			worker.queue.push_back(i);
+		}
+	}
+
+	_workAvailable.notify_all();
+}
+
+void ThreadPool::Wait() {
+	std::unique_lock lock(_mutex);
+	_workDone.wait(lock, [this]() { return _pending == 0; });
+}
+
+unsigned ThreadPool::Size() const {
+	return static_cast<unsigned>(_workers.size());
+}
+
+unsigned ThreadPool::ThreadCount(unsigned jobs) {
+	if (jobs == 0) {
+		jobs = std::thread::hardware_concurrency();
+	}
+
+	return jobs == 0 ? 1 : jobs;
+}
+
+void ThreadPool::WorkerLoop_(std::size_t self) {
+	std::size_t generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock lock(_mutex);
+			_workAvailable.wait(lock, [&]() { return _stop || _generation != generation; });
+
+			if (_stop) {
+				return;
+			}
+
+			generation = _generation;
+		}
+
+		std::size_t index;
+		while (Take_(self, index)) {
+			_task(index);
+
+			std::lock_guard lock(_mutex);
+			if (--_pending == 0) {
+				_workDone.notify_all();
+			}
+		}
+	}
+}
+
+bool ThreadPool::Take_(std::size_t self, std::size_t& index) {
+	// own queue first, front to back
+	{
+		Worker& worker = *_workers[self];
+		std::lock_guard lock(worker.mutex);
+
+		if (!worker.queue.empty()) {
+			index = worker.queue.front();
+			worker.queue.pop_front();
+			return true;
+		}
+	}
+
+	// steal from the back of the other queues
+	for (std::size_t i = 1; i < _workers.size(); i++) {
+		Worker& victim = *_workers[(self + i) % _workers.size()];
+		std::lock_guard lock(victim.mutex);
+
+		if (!victim.queue.empty()) {
+			index = victim.queue.back();
+			victim.queue.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022 Levi van Rheenen
+ */
+#ifndef GLWR_THREADPOOL_H
+#define GLWR_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A small work-stealing thread pool. Every worker owns a queue of task
+ * indices. A worker takes its own tasks front to back, so the work is done in
+ * roughly the order it was submitted, and steals from the back of the other
+ * queues once its own queue runs dry.
+ */
+class ThreadPool {
+
+public:
+	using Task = std::function<void(std::size_t)>;
+
+	explicit ThreadPool(unsigned threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/*
+	 * Runs task(i) for all i in [0, count). The indices are dealt round-robin
+	 * over the workers. Returns immediately; use Wait() to wait for completion.
+	 */
+	void Run(std::size_t count, Task task);
+
+	/*
+	 * Blocks until all tasks of the last Run() call have finished.
+	 */
+	void Wait();
+
+	unsigned Size() const;
+
+	/*
+	 * Returns the number of threads to use for a --jobs value, where 0 means
+	 * one thread per hardware thread.
+	 */
+	static unsigned ThreadCount(unsigned jobs);
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<std::size_t> queue;
+		std::thread thread;
+	};
+
+	void WorkerLoop_(std::size_t self);
+	bool Take_(std::size_t self, std::size_t& index);
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	Task _task;
+
+	std::mutex _mutex;
+	std::condition_variable _workAvailable;
+	std::condition_variable _workDone;
+	std::size_t _pending = 0;
+	std::size_t _generation = 0;
+	bool _stop = false;
+
+};
+
+#endif
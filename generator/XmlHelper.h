@@ -6,12 +6,188 @@
 
 #include <pugixml.hpp>
 
+#include <cstdint>
 #include <string_view>
 
+#include "PerfectHash.h"
+
 using Document = pugi::xml_document;
 using Node = pugi::xml_node;
 using Attribute = pugi::xml_attribute;
 
+/*
+ * The element and attribute names the refpages are parsed by. Every name is
+ * mapped to its token once, so the parsers can dispatch with a switch instead
+ * of comparing strings.
+ */
+enum class XmlName : std::uint8_t {
+	Unknown,
+	Text, // the empty name of text nodes
+
+	// elements
+	Citerefentry,
+	Code,
+	Colspec,
+	Constant,
+	Copyright,
+	Emphasis,
+	Entry,
+	Footnote,
+	Funcdef,
+	Funcprototype,
+	Funcsynopsis,
+	Function,
+	Glossdef,
+	Glossentry,
+	Glosslist,
+	Glossterm,
+	Holder,
+	Info,
+	Informalequation,
+	Informaltable,
+	Inlineequation,
+	Itemizedlist,
+	Link,
+	Listitem,
+	Manvolnum,
+	MmlMath,
+	MmlMfenced,
+	MmlMfrac,
+	MmlMi,
+	MmlMn,
+	MmlMo,
+	MmlMrow,
+	MmlMspace,
+	MmlMsub,
+	MmlMsup,
+	MmlMtable,
+	MmlMtd,
+	MmlMtext,
+	MmlMtr,
+	Para,
+	Paramdef,
+	Parameter,
+	Programlisting,
+	Refdescriptor,
+	Refentry,
+	Refentrytitle,
+	Refmeta,
+	Refname,
+	Refnamediv,
+	Refpurpose,
+	Refsect1,
+	Refsynopsisdiv,
+	Row,
+	Superscript,
+	Table,
+	Tbody,
+	Term,
+	Tgroup,
+	Thead,
+	Title,
+	Trademark,
+	Variablelist,
+	Varlistentry,
+	XiInclude,
+	Year,
+
+	// attributes
+	Class,
+	Close,
+	Href,
+	Mathvariant,
+	Open,
+	Role,
+	XlinkHref,
+	XmlId,
+	Xpointer
+};
+
+constexpr auto xmlNames = makePerfectHashMap<XmlName>({
+		{ "", XmlName::Text },
+		{ "citerefentry", XmlName::Citerefentry },
+		{ "code", XmlName::Code },
+		{ "colspec", XmlName::Colspec },
+		{ "constant", XmlName::Constant },
+		{ "copyright", XmlName::Copyright },
+		{ "emphasis", XmlName::Emphasis },
+		{ "entry", XmlName::Entry },
+		{ "footnote", XmlName::Footnote },
+		{ "funcdef", XmlName::Funcdef },
+		{ "funcprototype", XmlName::Funcprototype },
+		{ "funcsynopsis", XmlName::Funcsynopsis },
+		{ "function", XmlName::Function },
+		{ "glossdef", XmlName::Glossdef },
+		{ "glossentry", XmlName::Glossentry },
+		{ "glosslist", XmlName::Glosslist },
+		{ "glossterm", XmlName::Glossterm },
+		{ "holder", XmlName::Holder },
+		{ "info", XmlName::Info },
+		{ "informalequation", XmlName::Informalequation },
+		{ "informaltable", XmlName::Informaltable },
+		{ "inlineequation", XmlName::Inlineequation },
+		{ "itemizedlist", XmlName::Itemizedlist },
+		{ "link", XmlName::Link },
+		{ "listitem", XmlName::Listitem },
+		{ "manvolnum", XmlName::Manvolnum },
+		{ "mml:math", XmlName::MmlMath },
+		{ "mml:mfenced", XmlName::MmlMfenced },
+		{ "mml:mfrac", XmlName::MmlMfrac },
+		{ "mml:mi", XmlName::MmlMi },
+		{ "mml:mn", XmlName::MmlMn },
+		{ "mml:mo", XmlName::MmlMo },
+		{ "mml:mrow", XmlName::MmlMrow },
+		{ "mml:mspace", XmlName::MmlMspace },
+		{ "mml:msub", XmlName::MmlMsub },
+		{ "mml:msup", XmlName::MmlMsup },
+		{ "mml:mtable", XmlName::MmlMtable },
+		{ "mml:mtd", XmlName::MmlMtd },
+		{ "mml:mtext", XmlName::MmlMtext },
+		{ "mml:mtr", XmlName::MmlMtr },
+		{ "para", XmlName::Para },
+		{ "paramdef", XmlName::Paramdef },
+		{ "parameter", XmlName::Parameter },
+		{ "programlisting", XmlName::Programlisting },
+		{ "refdescriptor", XmlName::Refdescriptor },
+		{ "refentry", XmlName::Refentry },
+		{ "refentrytitle", XmlName::Refentrytitle },
+		{ "refmeta", XmlName::Refmeta },
+		{ "refname", XmlName::Refname },
+		{ "refnamediv", XmlName::Refnamediv },
+		{ "refpurpose", XmlName::Refpurpose },
+		{ "refsect1", XmlName::Refsect1 },
+		{ "refsynopsisdiv", XmlName::Refsynopsisdiv },
+		{ "row", XmlName::Row },
+		{ "superscript", XmlName::Superscript },
+		{ "table", XmlName::Table },
+		{ "tbody", XmlName::Tbody },
+		{ "term", XmlName::Term },
+		{ "tgroup", XmlName::Tgroup },
+		{ "thead", XmlName::Thead },
+		{ "title", XmlName::Title },
+		{ "trademark", XmlName::Trademark },
+		{ "variablelist", XmlName::Variablelist },
+		{ "varlistentry", XmlName::Varlistentry },
+		{ "xi:include", XmlName::XiInclude },
+		{ "year", XmlName::Year },
+		{ "class", XmlName::Class },
+		{ "close", XmlName::Close },
+		{ "href", XmlName::Href },
+		{ "mathvariant", XmlName::Mathvariant },
+		{ "open", XmlName::Open },
+		{ "role", XmlName::Role },
+		{ "xlink:href", XmlName::XlinkHref },
+		{ "xml:id", XmlName::XmlId },
+		{ "xpointer", XmlName::Xpointer }
+});
+
+constexpr XmlName xmlName(std::string_view name) {
+	return xmlNames.Find(name, XmlName::Unknown);
+}
+
+// the options every refpage and include is parsed with, in place
+constexpr unsigned xmlParseOptions = pugi::parse_default;
+
 class NodeNameIterator {
 
 public:
@@ -23,6 +199,7 @@ public:
 
 			if (node) {
 				name = node.name();
+				token = xmlName(name);
 			}
 		}
 
@@ -32,11 +209,14 @@ public:
 				return node;
 			} else if constexpr (I == 1) {
 				return name;
+			} else if constexpr (I == 2) {
+				return token;
 			}
 		}
 
 		Node node;
 		std::string_view name;
+		XmlName token = XmlName::Unknown;
 
 	};
 
@@ -89,7 +269,7 @@ namespace std {
 
 template<>
 struct tuple_size<NodeNameIterator::NodeName> :
-		std::integral_constant<size_t, 2> { };
+		std::integral_constant<size_t, 3> { };
 
 template<>
 struct tuple_element<0, NodeNameIterator::NodeName> {
@@ -101,31 +281,26 @@ struct tuple_element<1, NodeNameIterator::NodeName> {
 	using type = std::string_view;
 };
 
-}
-
-inline bool hasDescendant(Node node, std::string_view descendantName) {
-	for (const auto& [nd, nm] : NodeNameIterator(node)) {
-		if (nm == descendantName || hasDescendant(nd, descendantName)) {
-			return true;
-		}
-	}
+template<>
+struct tuple_element<2, NodeNameIterator::NodeName> {
+	using type = XmlName;
+};
 
-	return false;
 }
 
-inline Node firstChild(Node parent, std::string_view childName) {
-	for (const auto& [child, name] : NodeNameIterator(parent)) {
-		if (name == childName) {
-			return child;
+inline Node firstChild(Node parent, XmlName child) {
+	for (const auto& [node, name, token] : NodeNameIterator(parent)) {
+		if (token == child) {
+			return node;
 		}
 	}
 
 	return Node();
 }
 
-inline Attribute firstAttribute(Node node, std::string_view attributeName) {
+inline Attribute firstAttribute(Node node, XmlName attributeName) {
 	for (auto attribute : node.attributes()) {
-		if (attribute.name() == attributeName) {
+		if (xmlName(attribute.name()) == attributeName) {
 			return attribute;
 		}
 	}
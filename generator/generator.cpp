@@ -4,11 +4,32 @@
 #include <ctre.hpp>
 
 #include <algorithm>
+#include <bitset>
+#include <condition_variable>
 #include <cstring>
 #include <fstream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 
+#include "DocPool.h"
+#include "FileBuffer.h"
+#include "FileQueue.h"
+#include "FileWatcher.h"
+#include "Hash.h"
+#include "IncludeCache.h"
+#include "LaTeX.h"
+#include "Manifest.h"
+#include "OutputBuffer.h"
+#include "OutputFile.h"
 #include "Refpage.h"
+#include "RefpageCache.h"
+#include "RefpageSource.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
 constexpr static auto glfwHeaderHead = R"(#ifndef OPENGL_GLWR_H_
 #define OPENGL_GLWR_H_
@@ -31,64 +52,857 @@ constexpr static auto glfwHeaderTail = R"(
 #endif
 )";
 
-std::vector<std::string> getFunctionFiles(const std::filesystem::path& dir) {
-	std::vector<std::string> functionFiles;
+constexpr static auto sharedDocsHeader = "glwr_docs.h";
 
-	for (const auto& p : std::filesystem::directory_iterator(dir)) {
-		std::string filename = p.path().filename().string();
-		if (ctre::match<"gl[A-Z]\\w*\\.xml">(filename)) {
-			functionFiles.push_back(std::move(filename));
+// how long to wait for more changes after a file changed, in watch mode
+constexpr static std::chrono::milliseconds watchSettle(50);
+
+constexpr static auto sharedDocsHeaderHead = R"(#ifndef OPENGL_GLWR_DOCS_H_
+#define OPENGL_GLWR_DOCS_H_
+)";
+
+void writeGlwrHeader(const std::filesystem::path& path, const std::vector<std::string>& declarationNames, bool sharedDocs) {
+	OutputBuffer file;
+	file << glfwHeaderHead;
+
+	if (sharedDocs) {
+		file << "#include \"" << sharedDocsHeader << "\"\n";
+	}
+
+	for (const auto& declarationName : declarationNames) {
+		file << "#include \"func/" << declarationName << ".h\"\n";
+	}
+
+	file << glfwHeaderTail;
+	replaceFileIfChanged(path, file.View());
+}
+
+std::string generatorHash(const char* argv0) {
+	// The generator itself is an input of every page. Use the running binary
+	// if we can find it, otherwise never reuse a previous run.
+	std::filesystem::path self = "/proc/self/exe";
+	if (!std::filesystem::exists(self)) {
+		self = argv0;
+	}
+
+	FileBuffer buffer = FileBuffer::Map(self);
+	if (buffer.Size() == 0) {
+		return "";
+	}
+
+	return hashToString(fnv1a({ buffer.Data(), buffer.Size() }));
+}
+
+std::string escapeDepfilePath(const std::filesystem::path& path) {
+	std::string escaped;
+
+	for (char c : path.generic_string()) {
+		if (c == ' ' || c == '#' || c == '\\') {
+			escaped += '\\';
+		} else if (c == '$') {
+			escaped += '$';
 		}
+
+		escaped += c;
 	}
 
-	// on some systems the directory_iterator doesn't sort by name, so do it
-	// manually here.
-	std::sort(functionFiles.begin(), functionFiles.end());
+	return escaped;
+}
+
+void writeDepfile(const std::filesystem::path& path, const std::filesystem::path& target, const std::vector<std::filesystem::path>& dependencies) {
+	OutputBuffer file;
+	file << escapeDepfilePath(std::filesystem::absolute(target)) << ":";
 
-	return functionFiles;
+	for (const auto& dependency : dependencies) {
+		file << " \\\n  " << escapeDepfilePath(std::filesystem::absolute(dependency));
+	}
+
+	file << '\n';
+	replaceFileIfChanged(path, file.View());
 }
 
-void writeGlwrHeader(const std::filesystem::path& path, const std::vector<std::string>& declarationNames) {
-	std::ofstream file(path.string());
-	file << glfwHeaderHead;
+/*
+ * An option profile: the documentation sections of a header tree, and the
+ * directory it is written to.
+ */
+struct Profile {
+	std::filesystem::path dir;
+	std::string options;
+	includes sections;
+};
 
-	for (const auto& declarationName : declarationNames) {
-		file << "#include \"func/" << declarationName << ".h\"" << std::endl;
+struct Generation {
+	std::optional<RefpageSource> refpages;
+	std::vector<Profile> profiles;
+
+	// the previous run, if its pages can be reused
+	const Manifest* previous = nullptr;
+
+	// parsed refpages of earlier runs, and what their keys are salted with
+	std::optional<RefpageCache> cache;
+	std::uint64_t cacheSalt = 0;
+
+	// whether to record the stats of every page
+	bool stats = false;
+
+	// whether paragraphs that are on multiple pages are written to a shared
+	// docs header once
+	bool sharedDocs = false;
+
+	// where the headers are written in the background, if they are
+	FileQueue* files = nullptr;
+};
+
+Refpage parsePage(Generation& generation, const std::string& name, FileBuffer& input, std::uint64_t inputHash, std::ostream& log) {
+	if (!generation.cache) {
+		return Refpage(*generation.refpages, input.Span(), name, log);
 	}
 
-	file << glfwHeaderTail;
+	std::uint64_t key = fnv1a(hashToString(inputHash), generation.cacheSalt);
+
+	{
+		PhaseTimer timer(Phase::Cache);
+
+		if (auto refpage = generation.cache->Load(name, key, log)) {
+			return std::move(*refpage);
+		}
+	}
+
+	// keep the diagnostics, so that a cached page can repeat them
+	std::stringstream diagnostics;
+	Refpage refpage(*generation.refpages, input.Span(), name, diagnostics);
+	refpage.SetLog(log);
+
+	log << diagnostics.str();
+
+	PhaseTimer timer(Phase::Cache);
+	generation.cache->Store(refpage, key, diagnostics.str());
+	return refpage;
+}
+
+bool isUpToDate(Generation& generation, const std::string& name, const Manifest::Page& previous, const Manifest::Page& page) {
+	if (previous.input != page.input || previous.outputs.size() != generation.profiles.size()) {
+		return false;
+	}
+
+	for (const auto& [include, hash] : previous.includes) {
+		if (generation.refpages->Hash(include) != hash) {
+			return false;
+		}
+	}
+
+	for (std::size_t i = 0; i < generation.profiles.size(); i++) {
+		FileBuffer header = FileBuffer::Map(generation.profiles[i].dir / "func" / (name + ".h"));
+
+		if (header.Size() == 0 || fnv1a({ header.Data(), header.Size() }) != previous.outputs[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool generatePage(Generation& generation, const std::string& name, Manifest::Page& page, std::vector<std::string>& headers, std::ostream& log) {
+	FileBuffer input;
+
+	{
+		PhaseTimer timer(Phase::Read);
+
+		// hash the input before it is parsed in place
+		input = generation.refpages->Map(name + ".xml");
+		page.input = fnv1a({ input.Data(), input.Size() });
+
+		if (pageStats) {
+			pageStats->inputBytes += input.Size();
+		}
+
+		if (generation.previous) {
+			auto iter = generation.previous->pages.find(name);
+
+			if (iter != generation.previous->pages.end() && isUpToDate(generation, name, iter->second, page)) {
+				page = iter->second;
+				return false;
+			}
+		}
+	}
+
+	if (verbose) {
+		log << "Generating " << name << ".h" << std::endl;
+	}
+
+	// parse once, with the sections of all profiles, and emit every profile
+	Refpage refpage = parsePage(generation, name, input, page.input, log);
+
+	// Render each header into one buffer and write it at once. A header is
+	// usually about as large as its refpage, so start with room for that.
+	OutputBuffer functionHeader(input.Size());
+
+	for (const Profile& profile : generation.profiles) {
+		std::uint64_t documentation = pageStats ? pageStats->DocumentationBytes() : 0;
+
+		functionHeader.Clear();
+		refpage.GenerateHeader(functionHeader, profile.sections, generation.sharedDocs);
+
+		std::string_view contents = functionHeader.View();
+
+		if (pageStats) {
+			pageStats->outputBytes += contents.size();
+			pageStats->bytes[static_cast<std::size_t>(Section::Code)] += contents.size() - (pageStats->DocumentationBytes() - documentation);
+		}
+
+		// which paragraphs are shared is only known once all pages are
+		// generated, so keep the header until then
+		if (generation.sharedDocs) {
+			headers.emplace_back(contents);
+			continue;
+		}
+
+		page.outputs.push_back(fnv1a(contents));
+
+		PhaseTimer timer(Phase::Write);
+
+		// the queue takes the buffer itself, and the next header gets a new one
+		if (generation.files) {
+			generation.files->Write(profile.dir / "func" / (name + ".h"), functionHeader.Release());
+		} else {
+			replaceFileIfChanged(profile.dir / "func" / (name + ".h"), contents);
+		}
+	}
+
+	std::vector<std::string> includes = refpage.Includes();
+	std::sort(includes.begin(), includes.end());
+	includes.erase(std::unique(includes.begin(), includes.end()), includes.end());
+
+	for (auto& include : includes) {
+		std::uint64_t hash = generation.refpages->Hash(include);
+		page.includes.emplace_back(std::move(include), hash);
+	}
+
+	return true;
+}
+
+struct PageResult {
+	Manifest::Page page;
+	bool generated = false;
+	PageStats stats;
+
+	// with shared docs, the headers of every profile, before they are written
+	std::vector<std::string> headers;
+};
+
+bool generatePageResult(Generation& generation, const std::string& name, PageResult& result, std::ostream& log) {
+	StatsScope scope(generation.stats ? &result.stats : nullptr);
+	result.stats.name = name;
+	result.stats.generated = generatePage(generation, name, result.page, result.headers, log);
+	return result.stats.generated;
+}
+
+void generatePagesSerial(Generation& generation, const std::vector<std::string>& names, std::vector<PageResult>& results) {
+	for (std::size_t i = 0; i < names.size(); i++) {
+		results[i].generated = generatePageResult(generation, names[i], results[i], std::cout);
+	}
+}
+
+void generatePagesParallel(Generation& generation, const std::vector<std::string>& names, std::vector<PageResult>& results, unsigned jobs) {
+	struct PageLog {
+		std::stringstream log;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	std::vector<PageLog> logs(names.size());
+	std::mutex mutex;
+	std::condition_variable pageDone;
+
+	ThreadPool pool(jobs);
+	pool.Run(names.size(), [&](std::size_t i) {
+		PageLog& log = logs[i];
+
+		try {
+			results[i].generated = generatePageResult(generation, names[i], results[i], log.log);
+		} catch (...) {
+			log.error = std::current_exception();
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			log.done = true;
+		}
+
+		pageDone.notify_all();
+	});
+
+	// Output the diagnostics in page order, so that they are the same as with
+	// serial generation.
+	for (PageLog& log : logs) {
+		{
+			std::unique_lock lock(mutex);
+			pageDone.wait(lock, [&]() { return log.done; });
+		}
+
+		std::cout << log.log.str();
+
+		if (log.error) {
+			std::rethrow_exception(log.error);
+		}
+	}
+}
+
+void generatePages(Generation& generation, const std::vector<std::string>& names, std::vector<PageResult>& results, unsigned jobs) {
+	if (jobs > 1 && names.size() > 1) {
+		generatePagesParallel(generation, names, results, jobs);
+	} else {
+		generatePagesSerial(generation, names, results);
+	}
+}
+
+/*
+ * Calls found for every reference to the docs pool in header, with its offset
+ * and the block it refers to.
+ */
+template<typename F>
+void forEachDocReference(std::string_view header, const F& found) {
+	constexpr std::size_t hashSize = 16;
+
+	for (std::size_t pos = header.find(docReferencePrefix); pos != std::string_view::npos; pos = header.find(docReferencePrefix, pos + 1)) {
+		auto hash = hashFromString(header.substr(pos + docReferencePrefix.size(), hashSize));
+
+		if (const DocPool::Block* block = hash ? docPool.Find(*hash) : nullptr) {
+			found(pos, *block);
+		}
+	}
+}
+
+/*
+ * Writes the headers of a profile that were generated with shared docs. The
+ * paragraphs that are on more than one page, and are larger than a reference
+ * to them, are written to the shared docs header once. All other references
+ * are replaced by their paragraph. Returns the size of all headers of the
+ * profile without and with sharing.
+ */
+std::pair<std::uint64_t, std::uint64_t> writeSharedDocs(const Profile& profile, std::size_t index, const std::vector<std::string>& names, std::vector<PageResult>& results) {
+	constexpr std::size_t referenceSize = docReferencePrefix.size() + 17;
+
+	// count the pages every block is on
+	std::unordered_map<std::uint64_t, std::size_t> pages;
+	std::unordered_map<std::uint64_t, std::size_t> lastPage;
+
+	for (std::size_t i = 0; i < results.size(); i++) {
+		forEachDocReference(results[i].headers[index], [&](std::size_t, const DocPool::Block& block) {
+			if (auto [iter, inserted] = lastPage.try_emplace(block.hash, i); inserted || iter->second != i) {
+				iter->second = i;
+				pages[block.hash]++;
+			}
+		});
+	}
+
+	auto shared = [&](const DocPool::Block& block) {
+		return pages[block.hash] > 1 && block.text.size() > referenceSize;
+	};
+
+	std::uint64_t before = 0;
+	std::uint64_t after = 0;
+	std::vector<const DocPool::Block*> blocks;
+	OutputBuffer header;
+
+	for (std::size_t i = 0; i < results.size(); i++) {
+		PageResult& result = results[i];
+		std::string_view contents = result.headers[index];
+		std::size_t copied = 0;
+
+		header.Clear();
+		forEachDocReference(contents, [&](std::size_t pos, const DocPool::Block& block) {
+			if (shared(block)) {
+				before += block.text.size() - referenceSize;
+
+				if (lastPage[block.hash] != results.size()) {
+					lastPage[block.hash] = results.size();
+					blocks.push_back(&block);
+				}
+
+				return;
+			}
+
+			header << contents.substr(copied, pos - copied) << block.text;
+			copied = pos + referenceSize;
+		});
+
+		header << contents.substr(copied);
+
+		before += header.Size();
+		after += header.Size();
+
+		result.page.outputs.push_back(fnv1a(header.View()));
+		replaceFileIfChanged(profile.dir / "func" / (names[i] + ".h"), header.View());
+	}
+
+	// write every shared block once, as the documentation of a macro
+	std::sort(blocks.begin(), blocks.end(), [](const DocPool::Block* a, const DocPool::Block* b) {
+		return a->hash < b->hash;
+	});
+
+	OutputBuffer docs;
+	docs << sharedDocsHeaderHead;
+
+	for (const DocPool::Block* block : blocks) {
+		docs << '\n' << block->text << "#define GLWR_DOC_" << hashToString(block->hash) << '\n';
+	}
+
+	docs << glfwHeaderTail;
+	after += docs.Size();
+
+	replaceFileIfChanged(profile.dir / sharedDocsHeader, docs.View());
+	return { before, after };
+}
+
+/*
+ * Drops what the memos keep of paragraphs and equations that may be gone
+ * since, so that watching doesn't keep every version of them. Only the blocks
+ * that the headers kept for the shared docs refer to are still needed.
+ */
+void pruneMemos(const Generation& generation, const std::vector<PageResult>& results) {
+	std::unordered_set<std::uint64_t> used;
+
+	if (generation.sharedDocs) {
+		for (const PageResult& result : results) {
+			for (const std::string& header : result.headers) {
+				forEachDocReference(header, [&](std::size_t, const DocPool::Block& block) {
+					used.insert(block.hash);
+				});
+			}
+		}
+	}
+
+	docPool.Retain(used);
+	latexMemo.Clear();
+}
+
+/*
+ * The files that record a run, besides the headers.
+ */
+struct RunFiles {
+	std::optional<std::filesystem::path> manifest;
+	std::optional<std::filesystem::path> depfile;
+	std::optional<std::filesystem::path> stamp;
+};
+
+void writeRunFiles(Generation& generation, const Manifest& manifest, const RunFiles& outputs) {
+	if (outputs.manifest) {
+		manifest.Save(*outputs.manifest);
+	}
+
+	// list every file the headers were generated from
+	if (outputs.depfile) {
+		std::vector<std::filesystem::path> dependencies;
+
+		for (const auto& [name, page] : manifest.pages) {
+			dependencies.push_back(generation.refpages->Dependency(name + ".xml"));
+
+			for (const auto& [include, hash] : page.includes) {
+				dependencies.push_back(generation.refpages->Dependency(include));
+			}
+		}
+
+		std::sort(dependencies.begin(), dependencies.end());
+		dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+		writeDepfile(*outputs.depfile, outputs.stamp.value_or(generation.profiles.front().dir / "glwr.h"), dependencies);
+	}
+
+	// the stamp marks a complete run, so it is always written
+	if (outputs.stamp) {
+		std::ofstream stamp(*outputs.stamp, std::ios::trunc);
+		stamp << manifest.generator << std::endl;
+	}
+}
+
+/*
+ * Regenerates the pages that a change of the refpages affects, until the
+ * generator is stopped. The results of the last run stay in memory, with an
+ * index from every included file to the pages that include it, so only the
+ * pages that changed or include a file that changed are generated again.
+ */
+int watchRefpages(Generation& generation, Manifest& manifest, std::vector<std::string>& names, std::vector<PageResult>& results, const RunFiles& outputs, unsigned jobs) {
+	std::optional<FileWatcher> watcher;
+
+	try {
+		watcher.emplace();
+	} catch (const std::runtime_error& error) {
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+
+	std::filesystem::path dir = std::filesystem::absolute(generation.refpages->Directory()).lexically_normal();
+	watcher->Watch(dir);
+
+	// with shared docs, the shared docs header needs the headers of every
+	// page, so an affected page is always generated again
+	generation.previous = generation.sharedDocs ? nullptr : &manifest;
+
+	std::cout << "Watching " << dir.generic_string() << " for changes" << std::endl;
+
+	for (;;) {
+		std::unordered_map<std::string, std::vector<std::string>> includedBy;
+
+		for (const auto& [name, page] : manifest.pages) {
+			for (const auto& [include, hash] : page.includes) {
+				includedBy[include].push_back(name);
+				watcher->Watch((dir / include).parent_path());
+			}
+		}
+
+		FileWatcher::Changes changes = watcher->Wait(watchSettle);
+		auto start = PageStats::Clock::now();
+
+		// every file is named relative to the refpages, like the includes
+		std::vector<std::string> changed;
+
+		for (const auto& file : changes.files) {
+			changed.push_back(file.lexically_relative(dir).lexically_normal().generic_string());
+		}
+
+		if (changes.lost) {
+			for (const auto& [name, page] : manifest.pages) {
+				changed.push_back(name + ".xml");
+
+				for (const auto& [include, hash] : page.includes) {
+					changed.push_back(include);
+				}
+			}
+		}
+
+		// forget the files that changed, and find the pages they affect
+		std::set<std::string> affected;
+
+		for (const auto& file : changed) {
+			generation.refpages->Forget(file);
+			includeCache.Forget(file);
+
+			if (file.ends_with(".xml")) {
+				affected.insert(file.substr(0, file.size() - 4));
+			}
+
+			if (auto iter = includedBy.find(file); iter != includedBy.end()) {
+				affected.insert(iter->second.begin(), iter->second.end());
+			}
+		}
+
+		// pages that were added or removed change the page set
+		std::vector<std::string> pageNames;
+
+		for (const auto& function : generation.refpages->Pages()) {
+			pageNames.emplace_back(function.begin(), function.end() - 4);
+		}
+
+		bool pagesChanged = pageNames != names;
+
+		if (pagesChanged) {
+			std::unordered_map<std::string, PageResult> kept;
+
+			for (std::size_t i = 0; i < names.size(); i++) {
+				kept.emplace(std::move(names[i]), std::move(results[i]));
+			}
+
+			names = std::move(pageNames);
+			results = std::vector<PageResult>(names.size());
+
+			for (std::size_t i = 0; i < names.size(); i++) {
+				if (auto iter = kept.find(names[i]); iter != kept.end()) {
+					results[i] = std::move(iter->second);
+				} else {
+					affected.insert(names[i]);
+				}
+			}
+		}
+
+		std::vector<std::size_t> indices;
+		std::vector<std::string> affectedNames;
+
+		for (std::size_t i = 0; i < names.size(); i++) {
+			if (affected.contains(names[i])) {
+				indices.push_back(i);
+				affectedNames.push_back(names[i]);
+			}
+		}
+
+		if (indices.empty() && !pagesChanged) {
+			continue;
+		}
+
+		std::vector<PageResult> affectedResults(indices.size());
+		std::size_t generated = 0;
+
+		try {
+			generatePages(generation, affectedNames, affectedResults, jobs);
+
+			for (std::size_t i = 0; i < indices.size(); i++) {
+				generated += affectedResults[i].generated;
+				results[indices[i]] = std::move(affectedResults[i]);
+			}
+
+			if (generation.files) {
+				generation.files->Flush();
+			}
+
+			for (std::size_t i = 0; i < generation.profiles.size(); i++) {
+				const Profile& profile = generation.profiles[i];
+
+				if (pagesChanged) {
+					writeGlwrHeader(profile.dir / "glwr.h", names, generation.sharedDocs);
+				}
+
+				if (generation.sharedDocs) {
+					// the outputs of every page are recorded again
+					if (i == 0) {
+						for (PageResult& result : results) {
+							result.page.outputs.clear();
+						}
+					}
+
+					writeSharedDocs(profile, i, names, results);
+				}
+			}
+
+			manifest.pages.clear();
+
+			for (std::size_t i = 0; i < names.size(); i++) {
+				manifest.pages[names[i]] = results[i].page;
+			}
+
+			writeRunFiles(generation, manifest, outputs);
+			pruneMemos(generation, results);
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			continue;
+		}
+
+		auto time = std::chrono::duration_cast<std::chrono::milliseconds>(PageStats::Clock::now() - start).count();
+		std::cout << "Generated " << generated << " of " << indices.size() << " affected headers in " << time << " ms" << std::endl;
+	}
 }
 
 int main(int argc, char* argv[]) {
-	if (argc != 4) {
+	if (argc < 4) {
 		return -1;
 	}
 
-	auto gl4 = std::filesystem::current_path() / "opengl-refpages" / "gl4";
-	auto dir = std::filesystem::path(argv[1]);
+	Generation generation;
+	generation.profiles.push_back({ argv[1], argv[2], {} });
 
-	include.Parse(argv[2]);
 	verbose = std::strcmp(argv[3], "ON") == 0;
 
-	std::vector<std::string> functions = getFunctionFiles(gl4);
+	unsigned jobs = 1;
+	std::string_view io = "sync";
+	bool watch = false;
+	RunFiles outputs;
+	std::optional<std::filesystem::path> cachePath;
+	std::optional<std::filesystem::path> statsPath;
+	std::filesystem::path refpagesPath = std::filesystem::current_path() / "opengl-refpages";
+
+	for (int i = 4; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		if (arg == "--jobs" && i + 1 < argc) {
+			jobs = ThreadPool::ThreadCount(std::strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "--io" && i + 1 < argc) {
+			io = argv[++i];
+
+			if (io != "sync" && io != "threads" && io != "auto") {
+				std::cerr << "Unknown --io: " << io << " (expected sync, threads or auto)" << std::endl;
+				return -1;
+			}
+		} else if (arg == "--manifest" && i + 1 < argc) {
+			outputs.manifest = argv[++i];
+		} else if (arg == "--depfile" && i + 1 < argc) {
+			outputs.depfile = argv[++i];
+		} else if (arg == "--stamp" && i + 1 < argc) {
+			outputs.stamp = argv[++i];
+		} else if (arg == "--cache" && i + 1 < argc) {
+			cachePath = argv[++i];
+		} else if (arg == "--refpages" && i + 1 < argc) {
+			refpagesPath = argv[++i];
+		} else if (arg == "--stats" && i + 1 < argc) {
+			statsPath = argv[++i];
+		} else if (arg == "--shared-docs") {
+			generation.sharedDocs = true;
+		} else if (arg == "--watch") {
+			watch = true;
+		} else if (arg == "--profile" && i + 2 < argc) {
+			generation.profiles.push_back({ argv[i + 1], argv[i + 2], {} });
+			i += 2;
+		} else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return -1;
+		}
+	}
+
+	try {
+		generation.refpages.emplace(refpagesPath);
+	} catch (const std::runtime_error& error) {
+		std::cerr << error.what() << std::endl;
+		return -1;
+	}
+
+	// an archive is only read once
+	if (watch && generation.refpages->Directory().empty()) {
+		std::cerr << "Only a refpages directory can be watched" << std::endl;
+		return -1;
+	}
+
+	// the files may be rewritten while the watcher parses them
+	if (watch) {
+		generation.refpages->ReadIntoMemory();
+	}
+
+	// the pages are parsed with the sections of all profiles
+	unsigned long sections = 0;
+
+	for (Profile& profile : generation.profiles) {
+		profile.sections.Parse(profile.options.c_str());
+		sections |= std::strtoul(profile.options.c_str(), nullptr, 2);
+	}
+
+	std::string parseOptions = std::bitset<11>(sections).to_string();
+	include.Parse(parseOptions.c_str());
+
+	// load the previous run
+	Manifest manifest;
+	manifest.generator = generatorHash(argv[0]);
+
+	for (const Profile& profile : generation.profiles) {
+		if (!manifest.options.empty()) {
+			manifest.options += ',';
+		}
+
+		manifest.options += profile.options;
+	}
+
+	if (generation.sharedDocs) {
+		manifest.options += ",shared";
+	}
+
+	// with shared docs, the headers depend on all pages, so every page is
+	// generated again (from the cache, if it is unchanged)
+	Manifest previous;
+	if (outputs.manifest && !generation.sharedDocs) {
+		previous = Manifest::Load(*outputs.manifest);
+
+		if (manifest.Compatible(previous)) {
+			generation.previous = &previous;
+		}
+	}
+
+	// a cached page is only valid for the generator and options that parsed it
+	if (cachePath && !manifest.generator.empty()) {
+		generation.cache.emplace(*cachePath, *generation.refpages);
+		generation.cacheSalt = fnv1a(parseOptions, fnv1a(manifest.generator));
+	}
+
+	// generate the pages
+	std::vector<std::string> functions = generation.refpages->Pages();
 	std::vector<std::string> declarationNames;
 
 	for (const auto& function : functions) {
-		std::string name(function.begin(), function.end() - 4);
-		declarationNames.push_back(name);
+		declarationNames.emplace_back(function.begin(), function.end() - 4);
+	}
+
+	// Read the pages and the includes they had last time ahead of the
+	// generation, and write the headers behind it.
+	std::optional<FileQueue> files;
+
+	if (io != "sync") {
+		files.emplace(io == "auto", 4);
+		generation.files = &*files;
+
+		std::vector<std::filesystem::path> inputs;
+
+		for (const auto& function : functions) {
+			inputs.push_back(generation.refpages->Dependency(function));
+		}
+
+		for (const auto& [name, page] : previous.pages) {
+			for (const auto& [include, hash] : page.includes) {
+				inputs.push_back(generation.refpages->Dependency(include));
+			}
+		}
+
+		std::sort(inputs.begin(), inputs.end());
+		inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
 
-		if (verbose) {
-			std::cout << "Generating " << name << ".h" << std::endl;
+		for (const auto& input : inputs) {
+			files->Prefetch(input);
 		}
+	}
+
+	std::vector<PageResult> results(declarationNames.size());
+	generation.stats = statsPath.has_value();
+	auto start = PageStats::Clock::now();
+
+	generatePages(generation, declarationNames, results, jobs);
+
+	// the build only sees the headers once the stamp is written
+	if (files) {
+		try {
+			files->Flush();
+		} catch (const std::exception& error) {
+			std::cerr << error.what() << std::endl;
+			return -1;
+		}
+	}
+
+	for (std::size_t i = 0; i < generation.profiles.size(); i++) {
+		const Profile& profile = generation.profiles[i];
+		writeGlwrHeader(profile.dir / "glwr.h", declarationNames, generation.sharedDocs);
 
-		std::ifstream file(gl4 / function, std::ios::binary);
-		Refpage refpage(gl4, file, name);
+		if (generation.sharedDocs) {
+			auto [before, after] = writeSharedDocs(profile, i, declarationNames, results);
+
+			if (verbose || statsPath) {
+				std::cout << "Shared docs of " << profile.dir.generic_string() << ": " << before << " header bytes before, " << after << " after" << std::endl;
+			}
+		}
+	}
+
+	// save this run
+	std::size_t generated = 0;
+
+	// the results are kept to watch the refpages
+	for (std::size_t i = 0; i < declarationNames.size(); i++) {
+		manifest.pages[declarationNames[i]] = watch ? results[i].page : std::move(results[i].page);
+		generated += results[i].generated;
+	}
+
+	writeRunFiles(generation, manifest, outputs);
+
+	if (statsPath) {
+		auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(PageStats::Clock::now() - start).count();
+
+		std::vector<PageStats> stats;
+		for (auto& result : results) {
+			stats.push_back(std::move(result.stats));
+		}
+
+		std::stringstream json;
+		writeStatsJson(json, stats, wall, jobs);
+		replaceFileIfChanged(*statsPath, json.str());
+
+		writeStatsTable(std::cout, stats, wall);
+	}
+
+	if (verbose) {
+		std::cout << "Generated " << generated << " headers, " << declarationNames.size() - generated << " up to date" << std::endl;
+		std::cout << "Include cache: " << includeCache.Hits() << " hits, " << includeCache.Misses() << " misses" << std::endl;
+		std::cout << "LaTeX memo: " << latexMemo.Hits() << " hits, " << latexMemo.Misses() << " misses" << std::endl;
+		std::cout << "Doc pool: " << docPool.Hits() << " hits, " << docPool.Misses() << " misses" << std::endl;
+
+		if (files) {
+			std::cout << "File queue: " << (files->GetBackend() == FileQueue::Backend::IoUring ? "io_uring" : "threads") << std::endl;
+		}
+	}
 
-		std::filesystem::path functionHeaderPath = dir / "func" / (name + ".h");
-		std::ofstream functionHeader(functionHeaderPath.string());
-		refpage.GenerateHeader(functionHeader);
+	if (watch) {
+		return watchRefpages(generation, manifest, declarationNames, results, outputs, jobs);
 	}
 
-	writeGlwrHeader(dir / "glwr.h", declarationNames);
 	return 0;
 }
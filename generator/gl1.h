@@ -4,10 +4,13 @@
 #ifndef MGL_GL1_H
 #define MGL_GL1_H
 
-#include <unordered_set>
-#include <string>
+#include "PerfectHash.h"
 
-static const std::unordered_set<std::string> gl1 = {
+/*
+ * The functions of OpenGL 1.1, which are declared by the system headers instead
+ * of loaded by GLEW.
+ */
+constexpr auto gl1 = makePerfectHashSet({
 		"glAccum", "glAlphaFunc", "glAreTexturesResident", "glArrayElement",
 		"glBegin", "glBindTexture", "glBitmap", "glBlendFunc", "glCallList",
 		"glCallLists", "glClear", "glClearAccum", "glClearColor",
@@ -88,7 +91,7 @@ static const std::unordered_set<std::string> gl1 = {
 		"glVertex3fv", "glVertex3i", "glVertex3iv", "glVertex3s", "glVertex3sv",
 		"glVertex4d", "glVertex4dv", "glVertex4f", "glVertex4fv", "glVertex4i",
 		"glVertex4iv", "glVertex4s", "glVertex4sv", "glVertexPointer",
-		"glViewport",
-};
+		"glViewport"
+});
 
 #endif
\ No newline at end of file